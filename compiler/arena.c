@@ -0,0 +1,151 @@
+/*
+ * Arena (bump) allocator.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "counters.h"
+#include "log.h"
+
+/* Standard-size chunks kept for later arenas, off unless asked for */
+static pthread_mutex_t spare_lock = PTHREAD_MUTEX_INITIALIZER;
+static arena_chunk_t* spare_chunks = NULL;
+static size_t n_spare = 0;
+static size_t max_spare = 0;
+
+static arena_chunk_t* reuse_chunk(void)
+{
+        arena_chunk_t* chunk;
+
+        if (max_spare == 0) {
+                return NULL;
+        }
+
+        pthread_mutex_lock(&spare_lock);
+        chunk = spare_chunks;
+        if (chunk != NULL) {
+                spare_chunks = chunk->prev;
+                n_spare--;
+        }
+        pthread_mutex_unlock(&spare_lock);
+
+        return chunk;
+}
+
+static void release_chunk(arena_chunk_t* chunk)
+{
+        if (max_spare != 0 && chunk->end - chunk->data == ARENA_CHUNK_SIZE) {
+                pthread_mutex_lock(&spare_lock);
+                if (n_spare < max_spare) {
+                        chunk->prev = spare_chunks;
+                        spare_chunks = chunk;
+                        n_spare++;
+                        chunk = NULL;
+                }
+                pthread_mutex_unlock(&spare_lock);
+        }
+
+        free(chunk);
+}
+
+static arena_chunk_t* create_chunk(arena_t* arena, size_t size)
+{
+        arena_chunk_t* chunk;
+
+        /* Oversized allocations get a chunk of their own */
+        chunk = NULL;
+        if (size <= ARENA_CHUNK_SIZE) {
+                size = ARENA_CHUNK_SIZE;
+                chunk = reuse_chunk();
+        }
+
+        if (chunk == NULL) {
+                chunk = malloc(sizeof(arena_chunk_t) + size);
+                if (chunk == NULL) {
+                        return NULL;
+                }
+        }
+
+        counters.arena_reserved += size;
+
+        chunk->prev = arena->chunk;
+        chunk->end = chunk->data + size;
+        arena->chunk = chunk;
+        arena->pos = chunk->data;
+
+        return chunk;
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+        void* ptr;
+
+        size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+        if (arena->chunk == NULL || (size_t)(arena->chunk->end - arena->pos) < size) {
+                if (create_chunk(arena, size) == NULL) {
+                        return NULL;
+                }
+        }
+
+        ptr = arena->pos;
+        arena->pos += size;
+        counters.arena_bytes += size;
+        return ptr;
+}
+
+void arena_rewind(arena_t* arena, void* mark)
+{
+        arena_chunk_t* chunk;
+
+        /* Free every chunk allocated after the one holding the mark */
+        while ((chunk = arena->chunk) != NULL) {
+                if ((char*)mark >= chunk->data && (char*)mark <= chunk->end) {
+                        arena->pos = mark;
+                        return;
+                }
+
+                arena->chunk = chunk->prev;
+                release_chunk(chunk);
+        }
+
+        arena->pos = NULL;
+}
+
+void arena_destroy(arena_t* arena)
+{
+        arena_chunk_t* chunk;
+
+        debug("Destroying arena...");
+
+        while ((chunk = arena->chunk) != NULL) {
+                arena->chunk = chunk->prev;
+                release_chunk(chunk);
+        }
+
+        arena->pos = NULL;
+}
+
+void arena_keep_chunks(size_t max)
+{
+        arena_chunk_t* chunk;
+
+        pthread_mutex_lock(&spare_lock);
+        max_spare = max;
+        while (n_spare > max_spare) {
+                chunk = spare_chunks;
+                spare_chunks = chunk->prev;
+                n_spare--;
+                free(chunk);
+        }
+        pthread_mutex_unlock(&spare_lock);
+}
+
+void arena_init(arena_t* arena)
+{
+        arena->chunk = NULL;
+        arena->pos = NULL;
+}
@@ -0,0 +1,382 @@
+/*
+ * Generates large Quark programs for benchmarking.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_BUILTINS 6
+
+typedef struct {
+        size_t size;        /* Bytes of output to aim for */
+        unsigned int types; /* Types per 100 procedures */
+        unsigned int depth; /* Deepest chain of nested structs */
+        unsigned int params; /* Percent of procedures with a parameter */
+        unsigned int locals;
+        unsigned int calls;
+        unsigned int ifs;
+        uint64_t seed;
+} options_t;
+
+typedef struct {
+        bool param;
+        bool returns;
+} proc_info_t;
+
+static const char* builtins[N_BUILTINS] = { "uint8", "uint16", "uint32", "uint64", "uint", "char" };
+
+static options_t options = {
+        .size = 1024 * 1024,
+        .types = 20,
+        .depth = 3,
+        .params = 50,
+        .locals = 3,
+        .calls = 2,
+        .ifs = 1,
+        .seed = 1
+};
+
+static proc_info_t* procs = NULL;
+static size_t n_procs = 0;
+static size_t max_procs = 0;
+static unsigned int* struct_depths = NULL;
+static size_t n_structs = 0;
+static size_t max_structs = 0;
+static size_t n_aliases = 0;
+static size_t written = 0;
+
+static uint64_t next_random(void)
+{
+        /* xorshift64, so corpora are the same on every machine */
+        options.seed ^= options.seed << 13;
+        options.seed ^= options.seed >> 7;
+        options.seed ^= options.seed << 17;
+        return options.seed;
+}
+
+static size_t pick(size_t n)
+{
+        return (size_t)(next_random() % n);
+}
+
+static void out(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void out(const char* fmt, ...)
+{
+        va_list args;
+        int n;
+
+        va_start(args, fmt);
+        n = vprintf(fmt, args);
+        va_end(args);
+
+        if (n > 0) {
+                written += (size_t)n;
+        }
+}
+
+static void indent(unsigned int level)
+{
+        out("%*s", (int)level * 4, "");
+}
+
+static bool print_type(bool scalar)
+{
+        size_t choice;
+
+        /* Mostly builtins, sometimes a generated type */
+        choice = pick(N_BUILTINS + 2);
+        if (choice == N_BUILTINS && n_structs != 0 && !scalar) {
+                out("S%zu", pick(n_structs));
+                return false;
+        }
+
+        if (choice == N_BUILTINS + 1 && n_aliases != 0) {
+                out("A%zu", pick(n_aliases));
+        } else {
+                out("%s", builtins[choice % N_BUILTINS]);
+        }
+
+        return true;
+}
+
+static bool gen_struct(void)
+{
+        unsigned int depth;
+        size_t n_members;
+
+        if (n_structs == max_structs) {
+                unsigned int* grown;
+
+                max_structs = max_structs != 0 ? max_structs * 2 : 256;
+                grown = realloc(struct_depths, max_structs * sizeof(unsigned int));
+                if (grown == NULL) {
+                        return false;
+                }
+
+                struct_depths = grown;
+        }
+
+        out("type S%zu: struct {\n", n_structs);
+
+        /* Nest the previous struct while the chain is short enough */
+        depth = 1;
+        if (n_structs != 0 && struct_depths[n_structs - 1] < options.depth) {
+                depth = struct_depths[n_structs - 1] + 1;
+                out("    S%zu inner;\n", n_structs - 1);
+        }
+
+        n_members = 2 + pick(4);
+        for (size_t i = 0; i < n_members; i++) {
+                out("    %s%s m%zu;\n", builtins[pick(N_BUILTINS)], pick(4) == 0 ? "*" : "", i);
+        }
+        out("}\n\n");
+
+        struct_depths[n_structs++] = depth;
+        return true;
+}
+
+static void gen_alias(void)
+{
+        out("type A%zu: %s%s;\n\n", n_aliases++, builtins[pick(N_BUILTINS)], pick(4) == 0 ? "*" : "");
+}
+
+static void print_value(size_t n_locals, bool param, size_t proc)
+{
+        size_t choice, callee;
+
+        choice = pick(4);
+        if (choice == 0 && n_locals != 0) {
+                out("x%zu", pick(n_locals));
+        } else if (choice == 1 && param) {
+                out("a");
+        } else if (choice == 2 && proc != 0 && procs[callee = pick(proc)].returns) {
+                /* Only earlier procedures, since recursion is not supported yet */
+                out("p%zu(%s)", callee, procs[callee].param ? "1" : "");
+        } else {
+                out("%zu", pick(1000));
+        }
+}
+
+static void gen_call(unsigned int level, size_t n_locals, bool param, size_t proc)
+{
+        size_t callee;
+
+        if (proc == 0) {
+                return;
+        }
+
+        callee = pick(proc);
+        indent(level);
+        out("p%zu(", callee);
+        if (procs[callee].param) {
+                print_value(n_locals, param, 0);
+        }
+        out(");\n");
+}
+
+static size_t gen_local(unsigned int level, size_t n_locals, bool param, size_t proc, bool scalar)
+{
+        indent(level);
+        scalar = print_type(scalar);
+        out(" x%zu", n_locals);
+
+        /* Struct locals are left uninitialized */
+        if (!scalar || pick(3) == 0) {
+                out(";\n");
+                return n_locals + 1;
+        }
+
+        out(" = ");
+        print_value(n_locals, param, proc);
+        out(";\n");
+        return n_locals + 1;
+}
+
+static bool gen_procedure(void)
+{
+        proc_info_t* info;
+        size_t proc, n_locals;
+
+        if (n_procs == max_procs) {
+                proc_info_t* grown;
+
+                max_procs = max_procs != 0 ? max_procs * 2 : 1024;
+                grown = realloc(procs, max_procs * sizeof(proc_info_t));
+                if (grown == NULL) {
+                        return false;
+                }
+
+                procs = grown;
+        }
+
+        proc = n_procs;
+        info = &procs[proc];
+        info->param = pick(100) < options.params;
+        info->returns = pick(2) == 0;
+
+        out("proc p%zu(%s)%s {\n", proc, info->param ? "uint a" : "", info->returns ? " -> uint" : "");
+
+        n_locals = 0;
+        for (unsigned int i = 0; i < options.locals; i++) {
+                n_locals = gen_local(1, n_locals, info->param, proc, false);
+        }
+
+        for (unsigned int i = 0; i < options.calls; i++) {
+                gen_call(1, n_locals, info->param, proc);
+        }
+
+        for (unsigned int i = 0; i < options.ifs; i++) {
+                out("    if (");
+                print_value(n_locals, info->param, proc);
+                out(") {\n");
+
+                /* Locals in the body shadow nothing, so keep numbering */
+                gen_local(2, n_locals, info->param, proc, true);
+                gen_call(2, n_locals, info->param, proc);
+                if (info->returns) {
+                        out("        return x%zu;\n", n_locals);
+                }
+                out("    }\n");
+        }
+
+        /* Procedures without a value fall off the end */
+        if (info->returns) {
+                out("    return ");
+                print_value(n_locals, info->param, proc);
+                out(";\n");
+        }
+        out("}\n\n");
+
+        n_procs++;
+        return true;
+}
+
+static bool parse_size(const char* arg, size_t* size)
+{
+        char* end;
+
+        *size = strtoul(arg, &end, 10);
+        switch (*end) {
+        case 'K':
+        case 'k':
+                *size *= 1024;
+                end++;
+                break;
+        case 'M':
+        case 'm':
+                *size *= 1024 * 1024;
+                end++;
+                break;
+        case 'G':
+        case 'g':
+                *size *= 1024 * 1024 * 1024;
+                end++;
+                break;
+        default:
+                break;
+        }
+
+        return *end == '\0' && *size != 0;
+}
+
+static bool parse_args(int argc, char* argv[])
+{
+        static const struct {
+                const char* name;
+                unsigned int* value;
+        } counts[] = {
+                { "-t", &options.types },
+                { "-d", &options.depth },
+                { "-p", &options.params },
+                { "-l", &options.locals },
+                { "-c", &options.calls },
+                { "-f", &options.ifs }
+        };
+
+        for (int i = 1; i < argc; i++) {
+                bool found;
+                char* end;
+
+                if (i + 1 >= argc) {
+                        fprintf(stderr, "Expected a value after %s\n", argv[i]);
+                        return false;
+                }
+
+                if (strcmp(argv[i], "-s") == 0) {
+                        if (!parse_size(argv[++i], &options.size)) {
+                                fprintf(stderr, "Invalid size \"%s\"\n", argv[i]);
+                                return false;
+                        }
+
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-r") == 0) {
+                        options.seed = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || options.seed == 0) {
+                                fprintf(stderr, "Invalid seed \"%s\"\n", argv[i]);
+                                return false;
+                        }
+
+                        continue;
+                }
+
+                found = false;
+                for (size_t j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+                        if (strcmp(argv[i], counts[j].name) == 0) {
+                                *counts[j].value = (unsigned int)strtoul(argv[++i], &end, 10);
+                                found = *end == '\0';
+                                break;
+                        }
+                }
+
+                if (!found) {
+                        fprintf(stderr, "Invalid argument \"%s\"\n", argv[i]);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+int main(int argc, char* argv[])
+{
+        unsigned int type_credit;
+
+        if (!parse_args(argc, argv)) {
+                fprintf(stderr, "Usage: %s [-s size[K|M|G]] [-t types per 100 procs] [-d struct depth] [-p percent with parameter]\n", argv[0]);
+                fprintf(stderr, "       [-l locals] [-c calls] [-f ifs] [-r seed]\n");
+                return -1;
+        }
+
+        /* Spread types between procedures, as real code does */
+        type_credit = 0;
+        while (written < options.size) {
+                type_credit += options.types;
+                while (type_credit >= 100) {
+                        type_credit -= 100;
+                        if (pick(2) == 0) {
+                                gen_alias();
+                        } else if (!gen_struct()) {
+                                return -1;
+                        }
+                }
+
+                if (!gen_procedure()) {
+                        return -1;
+                }
+        }
+
+        out("pub proc main() -> uint {\n    return 0;\n}\n");
+
+        free(procs);
+        free(struct_depths);
+        return ferror(stdout) ? -1 : 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Hashmap microbenchmark.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash.h"
+#include "hashmap.h"
+#include "list.h"
+
+#define NAME_LENGTH 16
+#define LOOKUPS     (1 << 20)
+
+/*
+ * The previous hashmap: a fixed number of rows, each a linked list of
+ * entries matched on the hash alone. Kept here as the baseline.
+ */
+typedef struct {
+        list_entry_t list_entry;
+        hash_t hash;
+        void *value;
+} row_entry_t;
+
+static void rows_add(list_entry_t *rows, row_entry_t *entry, size_t n_rows)
+{
+        list_prepend(&rows[entry->hash % n_rows], &entry->list_entry);
+}
+
+static row_entry_t *rows_find(list_entry_t *rows, hash_t hash, size_t n_rows)
+{
+        list_entry_t *head;
+
+        head = &rows[hash % n_rows];
+        for (list_entry_t *entry = head->next; entry != head; entry = entry->next) {
+                if (((row_entry_t *)entry)->hash == hash) {
+                        return (row_entry_t *)entry;
+                }
+        }
+
+        return NULL;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *make_names(size_t n_names)
+{
+        char *names;
+
+        names = malloc(n_names * 2 * NAME_LENGTH);
+        for (size_t i = 0; i < n_names * 2; i++) {
+                snprintf(&names[i * NAME_LENGTH], NAME_LENGTH, "name_%08u", (unsigned int)i);
+        }
+
+        return names;
+}
+
+static void bench_rows(char *names, size_t n_names, size_t n_rows)
+{
+        list_entry_t *rows;
+        row_entry_t *entries;
+        volatile size_t found;
+        double start, add_time, find_time;
+
+        rows = malloc(n_rows * sizeof(list_entry_t));
+        entries = malloc(n_names * sizeof(row_entry_t));
+        for (size_t r = 0; r < n_rows; r++) {
+                list_init(&rows[r]);
+        }
+
+        start = now();
+        for (size_t i = 0; i < n_names; i++) {
+                entries[i].hash = hash_data(&names[i * NAME_LENGTH], NAME_LENGTH - 1);
+                entries[i].value = &entries[i];
+                rows_add(rows, &entries[i], n_rows);
+        }
+        add_time = now() - start;
+
+        /* Half hits, half misses */
+        found = 0;
+        start = now();
+        for (size_t i = 0; i < LOOKUPS; i++) {
+                char *name = &names[(i % (n_names * 2)) * NAME_LENGTH];
+
+                found += rows_find(rows, hash_data(name, NAME_LENGTH - 1), n_rows) != NULL;
+        }
+        find_time = now() - start;
+
+        printf("rows(%5zu)  %7zu names: add %7.1f ns/op, find %7.1f ns/op\n",
+                n_rows, n_names, add_time * 1e9 / n_names, find_time * 1e9 / LOOKUPS);
+
+        free(entries);
+        free(rows);
+}
+
+static void bench_open(char *names, size_t n_names)
+{
+        hashmap_t map;
+        volatile size_t found;
+        double start, add_time, find_time;
+
+        hashmap_init(&map, 16, NULL);
+
+        start = now();
+        for (size_t i = 0; i < n_names; i++) {
+                char *name = &names[i * NAME_LENGTH];
+
+                hashmap_add(&map, name, NAME_LENGTH - 1, hash_data(name, NAME_LENGTH - 1), name);
+        }
+        add_time = now() - start;
+
+        found = 0;
+        start = now();
+        for (size_t i = 0; i < LOOKUPS; i++) {
+                char *name = &names[(i % (n_names * 2)) * NAME_LENGTH];
+
+                found += hashmap_find(&map, name, NAME_LENGTH - 1, hash_data(name, NAME_LENGTH - 1)) != NULL;
+        }
+        find_time = now() - start;
+
+        printf("open addressing %7zu names: add %7.1f ns/op, find %7.1f ns/op\n",
+                n_names, add_time * 1e9 / n_names, find_time * 1e9 / LOOKUPS);
+
+        hashmap_destroy(&map);
+}
+
+int main(void)
+{
+        static const size_t sizes[] = { 16, 256, 4096, 16384 };
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                char *names;
+
+                names = make_names(sizes[s]);
+                bench_rows(names, sizes[s], 16);
+                bench_rows(names, sizes[s], 1024);
+                bench_open(names, sizes[s]);
+                printf("\n");
+                free(names);
+        }
+
+        return 0;
+}
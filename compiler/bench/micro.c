@@ -0,0 +1,603 @@
+/*
+ * Microbenchmarks for hashing, lookup, lexing and node primitives.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "counters.h"
+#include "hash.h"
+#include "hashmap.h"
+#include "intern.h"
+#include "lexer.h"
+#include "lexer/keyword.h"
+#include "parser/ast.h"
+#include "parser/scope.h"
+
+#define NAME_LENGTH  16
+#define MAX_KEY      64
+#define N_KEYS       4096
+#define MIN_RUN_NS   (5 * 1000 * 1000)
+#define WARMUP_NS    (50 * 1000 * 1000)
+#define MAX_SAMPLES  1000
+
+/*
+ * A benchmark runs n operations per call and returns how many bytes of
+ * input they covered, so results come out per operation.
+ */
+typedef size_t (*bench_fn_t)(void* context, size_t n);
+
+typedef struct {
+        char* keys; /* N_KEYS keys, MAX_KEY bytes apart */
+        size_t key_length;
+        size_t n_names;
+        hashmap_t map;
+        arena_t arena;
+} map_context_t;
+
+typedef struct {
+        char* source;
+        size_t size;
+        size_t n_tokens;
+} lex_context_t;
+
+typedef struct {
+        arena_t arena;
+        ast_t ast;
+        scope_t* inner;
+        name_t* names;
+        size_t n_names;
+} scope_context_t;
+
+typedef struct {
+        arena_t arena;
+        ast_t ast;
+        ast_node_t* root;
+} node_context_t;
+
+static size_t n_samples = 15;
+static const char* filter = NULL;
+static volatile uint64_t sink;
+
+static uint64_t now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+        double x, y;
+
+        x = *(const double*)a;
+        y = *(const double*)b;
+        return (x > y) - (x < y);
+}
+
+static void measure(const char* name, bench_fn_t fn, void* context)
+{
+        double samples[MAX_SAMPLES];
+        double mean, var, median;
+        uint64_t start, elapsed, arena_bytes;
+        size_t n, bytes;
+
+        if (filter != NULL && strstr(name, filter) == NULL) {
+                return;
+        }
+
+        /* Grow the batch until one run is long enough to time, which warms up too */
+        n = 1;
+        start = now();
+        for (;;) {
+                uint64_t run_start;
+
+                run_start = now();
+                fn(context, n);
+                elapsed = now() - run_start;
+                if (elapsed >= MIN_RUN_NS && now() - start >= WARMUP_NS) {
+                        break;
+                }
+
+                if (elapsed < MIN_RUN_NS) {
+                        n *= 2;
+                }
+        }
+
+        bytes = 0;
+        arena_bytes = counters.arena_bytes;
+        for (size_t i = 0; i < n_samples; i++) {
+                start = now();
+                bytes = fn(context, n);
+                samples[i] = (double)(now() - start) / n;
+        }
+        arena_bytes = counters.arena_bytes - arena_bytes;
+
+        mean = 0;
+        for (size_t i = 0; i < n_samples; i++) {
+                mean += samples[i];
+        }
+        mean /= n_samples;
+
+        var = 0;
+        for (size_t i = 0; i < n_samples; i++) {
+                var += (samples[i] - mean) * (samples[i] - mean);
+        }
+        var /= n_samples > 1 ? n_samples - 1 : 1;
+
+        qsort(samples, n_samples, sizeof(double), compare_doubles);
+        median = samples[n_samples / 2];
+
+        printf(
+                "%-28s %10.2f %10.2f %7.1f%% %10.1f %10.1f\n",
+                name,
+                median,
+                samples[0],
+                mean > 0 ? 100.0 * sqrt(var) / mean : 0,
+                (double)bytes / n,
+                (double)arena_bytes / ((double)n * n_samples)
+        );
+}
+
+static uint64_t next_random(uint64_t* state)
+{
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        return *state;
+}
+
+static char* make_keys(size_t length, uint64_t seed)
+{
+        char* keys;
+
+        keys = calloc(N_KEYS, MAX_KEY);
+        if (keys == NULL) {
+                return NULL;
+        }
+
+        /* Identifier characters, so keys look like names */
+        for (size_t i = 0; i < N_KEYS; i++) {
+                for (size_t j = 0; j < length; j++) {
+                        keys[i * MAX_KEY + j] = "abcdefghijklmnopqrstuvwxyz_0123456789"[next_random(&seed) % 37];
+                }
+        }
+
+        return keys;
+}
+
+static size_t bench_hash_data(void* context, size_t n)
+{
+        map_context_t* ctx;
+        hash_t hash;
+
+        ctx = context;
+        hash = 0;
+        for (size_t i = 0; i < n; i++) {
+                hash ^= hash_data(&ctx->keys[(i % N_KEYS) * MAX_KEY], ctx->key_length);
+        }
+
+        sink = hash;
+        return n * ctx->key_length;
+}
+
+static size_t bench_hash_string(void* context, size_t n)
+{
+        map_context_t* ctx;
+        hash_t hash;
+
+        ctx = context;
+        hash = 0;
+        for (size_t i = 0; i < n; i++) {
+                hash ^= hash_string(&ctx->keys[(i % N_KEYS) * MAX_KEY]);
+        }
+
+        sink = hash;
+        return n * ctx->key_length;
+}
+
+static size_t bench_hashmap_add(void* context, size_t n)
+{
+        map_context_t* ctx;
+        size_t done;
+        char* key;
+
+        /* Fill a fresh table, as each new scope or interner does */
+        ctx = context;
+        done = 0;
+        while (done < n) {
+                arena_init(&ctx->arena);
+                hashmap_init(&ctx->map, 16, &ctx->arena);
+                for (size_t i = 0; i < ctx->n_names && done < n; i++, done++) {
+                        key = &ctx->keys[i * MAX_KEY];
+                        hashmap_add(&ctx->map, key, ctx->key_length, hash_data(key, ctx->key_length), key);
+                }
+                hashmap_destroy(&ctx->map);
+                arena_destroy(&ctx->arena);
+        }
+
+        return n * ctx->key_length;
+}
+
+static size_t bench_hashmap_find(void* context, size_t n)
+{
+        map_context_t* ctx;
+        size_t found;
+        char* key;
+
+        /* Keys past n_names were never added */
+        ctx = context;
+        found = 0;
+        for (size_t i = 0; i < n; i++) {
+                key = &ctx->keys[(i % ctx->n_names) * MAX_KEY];
+                found += hashmap_find(&ctx->map, key, ctx->key_length, hash_data(key, ctx->key_length)) != NULL;
+        }
+
+        sink = found;
+        return n * ctx->key_length;
+}
+
+static void fill_map(map_context_t* ctx, size_t n_names, size_t offset)
+{
+        char* key;
+
+        arena_init(&ctx->arena);
+        hashmap_init(&ctx->map, 16, &ctx->arena);
+        for (size_t i = 0; i < n_names; i++) {
+                key = &ctx->keys[(i + offset) * MAX_KEY];
+                hashmap_add(&ctx->map, key, ctx->key_length, hash_data(key, ctx->key_length), key);
+        }
+        ctx->n_names = n_names;
+}
+
+static void run_hash_benches(void)
+{
+        static const size_t lengths[] = { 4, 8, 16, 32 };
+        static const size_t sizes[] = { 16, 256, 2048 };
+        map_context_t ctx;
+        char name[64];
+
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+                ctx.key_length = lengths[i];
+                ctx.keys = make_keys(ctx.key_length, 1);
+                if (ctx.keys == NULL) {
+                        return;
+                }
+
+                snprintf(name, sizeof(name), "hash_data/%zu", ctx.key_length);
+                measure(name, bench_hash_data, &ctx);
+                snprintf(name, sizeof(name), "hash_string/%zu", ctx.key_length);
+                measure(name, bench_hash_string, &ctx);
+                free(ctx.keys);
+        }
+
+        ctx.key_length = NAME_LENGTH;
+        ctx.keys = make_keys(ctx.key_length, 2);
+        if (ctx.keys == NULL) {
+                return;
+        }
+
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+                ctx.n_names = sizes[i];
+                snprintf(name, sizeof(name), "hashmap_add/%zu", sizes[i]);
+                measure(name, bench_hashmap_add, &ctx);
+
+                fill_map(&ctx, sizes[i], 0);
+                snprintf(name, sizeof(name), "hashmap_find/hit/%zu", sizes[i]);
+                measure(name, bench_hashmap_find, &ctx);
+                hashmap_destroy(&ctx.map);
+                arena_destroy(&ctx.arena);
+
+                /* Same keys, none of them present */
+                fill_map(&ctx, sizes[i], N_KEYS / 2);
+                snprintf(name, sizeof(name), "hashmap_find/miss/%zu", sizes[i]);
+                measure(name, bench_hashmap_find, &ctx);
+                hashmap_destroy(&ctx.map);
+                arena_destroy(&ctx.arena);
+        }
+
+        free(ctx.keys);
+}
+
+static size_t bench_intern(void* context, size_t n)
+{
+        const char** words;
+        symbol_t symbols;
+        size_t bytes, length;
+
+        /* Keywords are found in the shared table, other names in the local one */
+        words = context;
+        symbols = 0;
+        bytes = 0;
+        for (size_t i = 0, j = 0; i < n; i++, j++) {
+                if (words[j] == NULL) {
+                        j = 0;
+                }
+
+                length = strlen(words[j]);
+                symbols += keyword_kind(intern(words[j], length, hash_data(words[j], length)));
+                bytes += length;
+        }
+
+        sink = symbols;
+        return bytes;
+}
+
+static void run_intern_benches(void)
+{
+        static const char* keywords[] = { "pub", "type", "struct", "proc", "return", "if", NULL };
+        static const char* identifiers[] = { "uint32", "count", "parse_value", "x", "node_kind", "emitter", NULL };
+
+        measure("intern/keyword", bench_intern, keywords);
+        measure("intern/identifier", bench_intern, identifiers);
+}
+
+static size_t bench_lexer(void* context, size_t n)
+{
+        lex_context_t* ctx;
+        lexer_t lexer;
+        token_t token;
+        size_t count;
+
+        /* Whole passes over the source, counted in tokens */
+        ctx = context;
+        count = 0;
+        while (count < n) {
+                lexer_init(&lexer, ctx->source);
+                do {
+                        lexer_next(&lexer, &token);
+                        count++;
+                } while (token.kind != TK_EOF);
+        }
+
+        return (size_t)((double)count / ctx->n_tokens * ctx->size);
+}
+
+static bool make_source(lex_context_t* ctx, const char* const* pieces, size_t size)
+{
+        lexer_t lexer;
+        token_t token;
+        const char* piece;
+        uint64_t seed;
+        size_t n_pieces, length;
+
+        for (n_pieces = 0; pieces[n_pieces] != NULL; n_pieces++);
+
+        ctx->source = calloc(1, size + MAX_KEY + LEXER_PADDING);
+        if (ctx->source == NULL) {
+                return false;
+        }
+
+        seed = 3;
+        ctx->size = 0;
+        while (ctx->size < size) {
+                piece = pieces[next_random(&seed) % n_pieces];
+                length = strlen(piece);
+                memcpy(&ctx->source[ctx->size], piece, length);
+                ctx->size += length;
+        }
+
+        ctx->n_tokens = 0;
+        lexer_init(&lexer, ctx->source);
+        do {
+                lexer_next(&lexer, &token);
+                ctx->n_tokens++;
+        } while (token.kind != TK_EOF);
+
+        return true;
+}
+
+static void run_lexer_benches(void)
+{
+        static const char* identifiers[] = { "count ", "x ", "parse_value ", "node_kind\n", "emitter ", "uint32 ", NULL };
+        static const char* numbers[] = { "1 ", "42 ", "0x1f ", "0b101 ", "1000000\n", NULL };
+        static const char* operators[] = { "+ ", "-> ", "++ ", "* ", "== ", "( ", ") ", "; ", "{\n", "}\n", NULL };
+        static const char* program[] = {
+                "proc p(uint a) -> uint {\n",
+                "    uint32 x0 = a;\n",
+                "    p1(x0);\n",
+                "    if (x0) {\n        return 42;\n    }\n",
+                "    return 0;\n}\n\n",
+                "type S: struct {\n    uint8* m0;\n    uint64 m1;\n}\n\n",
+                "    char c = 'c';\n",
+                "    print(\"a string\");\n",
+                NULL
+        };
+        static const struct {
+                const char* name;
+                const char* const* pieces;
+        } mixes[] = {
+                { "lexer_next/identifiers", identifiers },
+                { "lexer_next/numbers", numbers },
+                { "lexer_next/operators", operators },
+                { "lexer_next/program", program }
+        };
+        lex_context_t ctx;
+
+        for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+                if (!make_source(&ctx, mixes[i].pieces, 64 * 1024)) {
+                        return;
+                }
+
+                measure(mixes[i].name, bench_lexer, &ctx);
+                free(ctx.source);
+        }
+}
+
+static size_t bench_scope_find(void* context, size_t n)
+{
+        scope_context_t* ctx;
+        size_t found;
+
+        ctx = context;
+        found = 0;
+        for (size_t i = 0; i < n; i++) {
+                found += scope_find(ctx->inner, &ctx->names[i % ctx->n_names]) != NULL;
+        }
+
+        sink = found;
+        return 0;
+}
+
+static bool make_scopes(scope_context_t* ctx, size_t size, size_t depth)
+{
+        scope_t* outer;
+        ast_node_t* node;
+        char name[NAME_LENGTH];
+        size_t length;
+
+        arena_init(&ctx->arena);
+        ast_init(&ctx->ast, &ctx->arena);
+        ctx->names = malloc(size * 2 * sizeof(name_t));
+        if (ctx->names == NULL) {
+                return false;
+        }
+
+        /* Names live in the outermost scope, lookups start at the innermost */
+        outer = create_scope(&ctx->arena, NULL, GLOBAL_SCOPE_SIZE);
+        if (outer == NULL) {
+                return false;
+        }
+
+        for (size_t i = 0; i < size * 2; i++) {
+                length = (size_t)snprintf(name, sizeof(name), "name_%zu", i);
+                symbol_name(intern(name, length, hash_data(name, length)), &ctx->names[i]);
+                if (i >= size) {
+                        continue;
+                }
+
+                node = create_node(&ctx->ast, NULL);
+                if (node == NULL) {
+                        return false;
+                }
+
+                node->name = ctx->names[i];
+                scope_add(outer, node);
+        }
+
+        ctx->inner = outer;
+        for (size_t i = 1; i < depth; i++) {
+                ctx->inner = create_scope(&ctx->arena, ctx->inner, LOCAL_SCOPE_SIZE);
+                if (ctx->inner == NULL) {
+                        return false;
+                }
+        }
+
+        ctx->n_names = size;
+        return true;
+}
+
+static void run_scope_benches(void)
+{
+        static const size_t sizes[] = { 16, 256, 4096 };
+        static const size_t depths[] = { 1, 4 };
+        scope_context_t ctx;
+        name_t* names;
+        char name[64];
+
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+                for (size_t j = 0; j < sizeof(depths) / sizeof(depths[0]); j++) {
+                        if (make_scopes(&ctx, sizes[i], depths[j])) {
+                                snprintf(name, sizeof(name), "scope_find/hit/%zu/depth%zu", sizes[i], depths[j]);
+                                measure(name, bench_scope_find, &ctx);
+
+                                /* The second half of the names was never added */
+                                names = ctx.names;
+                                ctx.names += sizes[i];
+                                snprintf(name, sizeof(name), "scope_find/miss/%zu/depth%zu", sizes[i], depths[j]);
+                                measure(name, bench_scope_find, &ctx);
+                                ctx.names = names;
+                        }
+
+                        free(ctx.names);
+                        ast_destroy(&ctx.ast);
+                        arena_destroy(&ctx.arena);
+                }
+        }
+}
+
+static size_t bench_nodes(void* context, size_t n)
+{
+        node_context_t* ctx;
+        ast_node_t* top;
+        ast_node_t* node;
+        size_t done;
+
+        /* Build a declaration's worth of nodes, then throw it away */
+        ctx = context;
+        done = 0;
+        while (done < n) {
+                top = create_node(&ctx->ast, ctx->root);
+                node = top;
+                done++;
+                for (size_t i = 1; i < 256 && done < n; i++, done++) {
+                        node = create_node(&ctx->ast, i % 8 == 0 ? top : node);
+                }
+                delete_nodes(&ctx->ast, top);
+        }
+
+        return 0;
+}
+
+static void run_node_benches(void)
+{
+        node_context_t ctx;
+
+        arena_init(&ctx.arena);
+        ast_init(&ctx.ast, &ctx.arena);
+        ctx.root = create_node(&ctx.ast, NULL);
+        if (ctx.root != NULL) {
+                ctx.ast.pinned = ctx.root->id;
+                measure("create_node+delete_nodes", bench_nodes, &ctx);
+        }
+
+        ast_destroy(&ctx.ast);
+        arena_destroy(&ctx.arena);
+}
+
+int main(int argc, char* argv[])
+{
+        interner_t interner;
+        int arg;
+
+        arg = 1;
+        if (arg + 1 < argc && strcmp(argv[arg], "-n") == 0) {
+                n_samples = strtoul(argv[arg + 1], NULL, 10);
+                arg += 2;
+        }
+
+        if (argc > arg + 1 || n_samples == 0 || n_samples > MAX_SAMPLES) {
+                fprintf(stderr, "Usage: %s [-n samples] [filter]\n", argv[0]);
+                return -1;
+        }
+
+        if (arg < argc) {
+                filter = argv[arg];
+        }
+
+        if (!intern_init() || !interner_init(&interner)) {
+                fprintf(stderr, "Failed to initialize interner\n");
+                return -1;
+        }
+
+        printf("median and min of %zu samples, in B/op is input covered, alloc B/op is arena memory\n", n_samples);
+        printf("%-28s %10s %10s %8s %10s %10s\n", "benchmark", "ns/op", "min", "stddev", "in B/op", "alloc B/op");
+
+        run_hash_benches();
+        run_intern_benches();
+        run_lexer_benches();
+        run_scope_benches();
+        run_node_benches();
+
+        interner_destroy(&interner);
+        intern_destroy();
+        return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Compile throughput benchmark.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define REPORT_SIZE (64 * 1024)
+#define N_PHASES    5
+#define MAX_EXTRA   16
+
+typedef struct {
+        double wall[N_PHASES];
+        double run;
+        unsigned long lines;
+        unsigned long tokens;
+        unsigned long source_bytes;
+} result_t;
+
+static const char* phase_names[N_PHASES] = { "load", "lex", "parse", "codegen", "output" };
+
+static const char* extra_args[MAX_EXTRA];
+static const char* quarkc;
+static size_t n_extra = 0;
+static size_t n_runs = 5;
+static char report_path[] = "/tmp/quark-bench-XXXXXX";
+
+static bool find_number(const char* report, const char* key, double* value)
+{
+        const char* pos;
+        char* end;
+
+        pos = strstr(report, key);
+        if (pos == NULL) {
+                return false;
+        }
+
+        *value = strtod(pos + strlen(key), &end);
+        return end != pos + strlen(key);
+}
+
+static bool read_report(result_t* result)
+{
+        char report[REPORT_SIZE];
+        char key[64];
+        const char* phases;
+        double value;
+        ssize_t size;
+        int fd;
+
+        fd = open(report_path, O_RDONLY);
+        if (fd < 0) {
+                return false;
+        }
+
+        size = read(fd, report, sizeof(report) - 1);
+        close(fd);
+        if (size <= 0) {
+                return false;
+        }
+        report[size] = '\0';
+
+        /* The report is written by quarkc, so its layout is known */
+        phases = strstr(report, "\"phases\"");
+        if (phases == NULL || !find_number(report, "\"run\": {\"wall_ms\": ", &result->run)) {
+                return false;
+        }
+
+        for (int i = 0; i < N_PHASES; i++) {
+                snprintf(key, sizeof(key), "\"%s\": {\"wall_ms\": ", phase_names[i]);
+                if (!find_number(phases, key, &result->wall[i])) {
+                        return false;
+                }
+        }
+
+        if (!find_number(report, "\"lines\": ", &value)) {
+                return false;
+        }
+        result->lines = (unsigned long)value;
+
+        if (!find_number(report, "\"tokens\": ", &value)) {
+                return false;
+        }
+        result->tokens = (unsigned long)value;
+
+        if (!find_number(report, "\"source_bytes\": ", &value)) {
+                return false;
+        }
+        result->source_bytes = (unsigned long)value;
+
+        return true;
+}
+
+static bool run_once(const char* input, result_t* result)
+{
+        const char* args[MAX_EXTRA + 8];
+        int status, null_fd;
+        size_t n_args;
+        pid_t pid;
+
+        n_args = 0;
+        args[n_args++] = quarkc;
+        args[n_args++] = "-i";
+        args[n_args++] = input;
+        args[n_args++] = "-o";
+        args[n_args++] = "/dev/null";
+        args[n_args++] = "--report-json";
+        args[n_args++] = report_path;
+        for (size_t i = 0; i < n_extra; i++) {
+                args[n_args++] = extra_args[i];
+        }
+        args[n_args] = NULL;
+
+        pid = fork();
+        if (pid < 0) {
+                return false;
+        }
+
+        if (pid == 0) {
+                /* Only the report is wanted */
+                null_fd = open("/dev/null", O_WRONLY);
+                if (null_fd >= 0) {
+                        dup2(null_fd, STDOUT_FILENO);
+                        dup2(null_fd, STDERR_FILENO);
+                }
+
+                execv(quarkc, (char* const*)args);
+                _exit(127);
+        }
+
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+                return false;
+        }
+
+        return read_report(result);
+}
+
+static double per_second(unsigned long count, double ms)
+{
+        return ms > 0 ? count / (ms / 1000.0) : 0;
+}
+
+static bool bench_input(const char* input)
+{
+        result_t best, result;
+        double total;
+
+        if (!run_once(input, &best)) {
+                fprintf(stderr, "Failed to run %s on %s\n", quarkc, input);
+                return false;
+        }
+
+        /* Each phase keeps its own best time */
+        for (size_t run = 1; run < n_runs; run++) {
+                if (!run_once(input, &result)) {
+                        fprintf(stderr, "Failed to run %s on %s\n", quarkc, input);
+                        return false;
+                }
+
+                for (int i = 0; i < N_PHASES; i++) {
+                        if (result.wall[i] < best.wall[i]) {
+                                best.wall[i] = result.wall[i];
+                        }
+                }
+
+                if (result.run < best.run) {
+                        best.run = result.run;
+                }
+        }
+
+        printf("%s: %lu byte(s), %lu line(s), %lu token(s), best of %zu\n", input, best.source_bytes, best.lines, best.tokens, n_runs);
+        printf("  %-10s %12s %14s %14s\n", "phase", "wall (ms)", "lines/s", "tokens/s");
+
+        total = 0;
+        for (int i = 0; i < N_PHASES; i++) {
+                printf(
+                        "  %-10s %12.3f %14.0f %14.0f\n",
+                        phase_names[i],
+                        best.wall[i],
+                        per_second(best.lines, best.wall[i]),
+                        per_second(best.tokens, best.wall[i])
+                );
+                total += best.wall[i];
+        }
+
+        printf("  %-10s %12.3f %14.0f %14.0f\n", "total", total, per_second(best.lines, total), per_second(best.tokens, total));
+        printf("  %-10s %12.3f %14.0f %14.0f\n\n", "run", best.run, per_second(best.lines, best.run), per_second(best.tokens, best.run));
+        return true;
+}
+
+int main(int argc, char* argv[])
+{
+        bool status;
+        int arg, fd;
+
+        arg = 1;
+        while (arg + 1 < argc && argv[arg][0] == '-') {
+                if (strcmp(argv[arg], "-n") == 0) {
+                        n_runs = strtoul(argv[arg + 1], NULL, 10);
+                } else if (strcmp(argv[arg], "-x") == 0 && n_extra < MAX_EXTRA) {
+                        /* Passed on to quarkc, e.g. to compare two ways of compiling */
+                        extra_args[n_extra++] = argv[arg + 1];
+                } else {
+                        break;
+                }
+                arg += 2;
+        }
+
+        if (arg >= argc - 1 || n_runs == 0) {
+                fprintf(stderr, "Usage: %s [-n runs] [-x quarkc-arg]... <quarkc> <input>...\n", argv[0]);
+                return -1;
+        }
+        quarkc = argv[arg++];
+
+        fd = mkstemp(report_path);
+        if (fd < 0) {
+                perror(report_path);
+                return -1;
+        }
+        close(fd);
+
+        status = true;
+        for (; arg < argc && status; arg++) {
+                status = bench_input(argv[arg]);
+        }
+
+        unlink(report_path);
+        return status ? 0 : -1;
+}
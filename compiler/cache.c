@@ -0,0 +1,359 @@
+/*
+ * Content-addressed output cache.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "log.h"
+#include "version.h"
+
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+        char* path;
+        off_t size;
+        time_t mtime;
+} cache_entry_t;
+
+static atomic_uint temp_counter;
+
+/* Any rebuild of the compiler may change its output */
+static pthread_once_t build_once = PTHREAD_ONCE_INIT;
+static uint8_t build_digest[SHA256_SIZE];
+
+static void hash_build(void)
+{
+        static const char fallback[] = "quarkc " QUARK_VERSION " " __DATE__ " " __TIME__;
+        char buffer[COPY_BUFFER_SIZE];
+        sha256_t ctx;
+        ssize_t n;
+        int fd;
+
+        sha256_init(&ctx);
+        fd = open("/proc/self/exe", O_RDONLY);
+        if (fd < 0) {
+                sha256_update(&ctx, fallback, sizeof(fallback));
+                sha256_final(&ctx, build_digest);
+                return;
+        }
+
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+                sha256_update(&ctx, buffer, (size_t)n);
+        }
+
+        /* A binary that could not be read whole is told apart by when it was built */
+        if (n < 0) {
+                sha256_update(&ctx, fallback, sizeof(fallback));
+        }
+
+        close(fd);
+        sha256_final(&ctx, build_digest);
+}
+
+static void format_path(cache_t* cache, cache_key_t* key, char* path, bool subdir_only)
+{
+        static const char hex[] = "0123456789abcdef";
+        char* end;
+
+        end = path + sprintf(path, "%s/", cache->dir);
+        for (int i = 0; i < SHA256_SIZE; i++) {
+                *end++ = hex[key->digest[i] >> 4];
+                *end++ = hex[key->digest[i] & 0xf];
+
+                /* First byte picks the subdirectory */
+                if (i == 0) {
+                        if (subdir_only) {
+                                break;
+                        }
+
+                        *end++ = '/';
+                }
+        }
+
+        *end = '\0';
+}
+
+static bool copy_fd(int in, int out)
+{
+        char buffer[COPY_BUFFER_SIZE];
+        ssize_t n_read, n_written;
+        ssize_t done;
+
+        for (;;) {
+                n_read = read(in, buffer, sizeof(buffer));
+                if (n_read < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n_read <= 0) {
+                        return n_read == 0;
+                }
+
+                for (done = 0; done < n_read; done += n_written) {
+                        n_written = write(out, buffer + done, (size_t)(n_read - done));
+                        if (n_written < 0 && errno == EINTR) {
+                                n_written = 0;
+                                continue;
+                        }
+                        if (n_written < 0) {
+                                return false;
+                        }
+                }
+        }
+}
+
+void cache_key(cache_key_t* key, const uint8_t options[SHA256_SIZE], const char* source, size_t size)
+{
+        sha256_t ctx;
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, build_digest, SHA256_SIZE);
+        sha256_update(&ctx, options, SHA256_SIZE);
+        sha256_update(&ctx, source, size);
+        sha256_final(&ctx, key->digest);
+}
+
+bool cache_fetch(cache_t* cache, cache_key_t* key, const char* output_filename)
+{
+        char path[PATH_MAX];
+        int entry_fd, output_fd;
+        bool status;
+
+        format_path(cache, key, path, false);
+        entry_fd = open(path, O_RDONLY);
+        if (entry_fd < 0) {
+                atomic_fetch_add(&cache->misses, 1);
+                return false;
+        }
+
+        output_fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0) {
+                close(entry_fd);
+                atomic_fetch_add(&cache->misses, 1);
+                return false;
+        }
+
+        status = copy_fd(entry_fd, output_fd);
+        close(output_fd);
+
+        /* Touch the entry so eviction sees it as recently used */
+        futimens(entry_fd, NULL);
+        close(entry_fd);
+
+        atomic_fetch_add(status ? &cache->hits : &cache->misses, 1);
+        return status;
+}
+
+bool cache_store(cache_t* cache, cache_key_t* key, const char* output_filename)
+{
+        char path[PATH_MAX], temp_path[PATH_MAX];
+        int output_fd, temp_fd;
+        bool status;
+
+        format_path(cache, key, path, true);
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+                return false;
+        }
+
+        /* Unique within the process, and the pid covers other processes */
+        if (snprintf(temp_path, sizeof(temp_path), "%s/.tmp-%ld-%u", path, (long)getpid(), atomic_fetch_add(&temp_counter, 1)) >= (int)sizeof(temp_path)) {
+                return false;
+        }
+        format_path(cache, key, path, false);
+
+        output_fd = open(output_filename, O_RDONLY);
+        if (output_fd < 0) {
+                return false;
+        }
+
+        temp_fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (temp_fd < 0) {
+                close(output_fd);
+                return false;
+        }
+
+        status = copy_fd(output_fd, temp_fd);
+        close(output_fd);
+        status = close(temp_fd) == 0 && status;
+
+        if (!status || rename(temp_path, path) < 0) {
+                unlink(temp_path);
+                return false;
+        }
+
+        atomic_fetch_add(&cache->stores, 1);
+        return true;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+        const cache_entry_t* entry_a = a;
+        const cache_entry_t* entry_b = b;
+
+        return (entry_a->mtime > entry_b->mtime) - (entry_a->mtime < entry_b->mtime);
+}
+
+static bool collect_entries(const char* subdir, time_t now, cache_entry_t** entries, size_t* count, size_t* capacity, off_t* total)
+{
+        char path[PATH_MAX];
+        struct dirent* dirent;
+        struct stat st;
+        DIR* dir;
+
+        dir = opendir(subdir);
+        if (dir == NULL) {
+                return true;
+        }
+
+        while ((dirent = readdir(dir)) != NULL) {
+                /* Skip "." and ".." */
+                if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+                        continue;
+                }
+
+                /* A truncated path would name some other file */
+                if (snprintf(path, sizeof(path), "%s/%s", subdir, dirent->d_name) >= (int)sizeof(path)) {
+                        continue;
+                }
+
+                if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+                        continue;
+                }
+
+                /* Temporary files may still be written, unless they are long abandoned */
+                if (dirent->d_name[0] == '.') {
+                        if (strncmp(dirent->d_name, ".tmp-", 5) == 0 && now - st.st_mtime > CACHE_TEMP_MAX_AGE) {
+                                unlink(path);
+                        }
+
+                        continue;
+                }
+
+                if (*count == *capacity) {
+                        cache_entry_t* grown;
+
+                        *capacity = *capacity != 0 ? *capacity * 2 : 256;
+                        grown = realloc(*entries, *capacity * sizeof(cache_entry_t));
+                        if (grown == NULL) {
+                                closedir(dir);
+                                return false;
+                        }
+
+                        *entries = grown;
+                }
+
+                (*entries)[*count].path = strdup(path);
+                if ((*entries)[*count].path == NULL) {
+                        closedir(dir);
+                        return false;
+                }
+
+                (*entries)[*count].size = st.st_size;
+                (*entries)[*count].mtime = st.st_mtime;
+                (*count)++;
+                *total += st.st_size;
+        }
+
+        closedir(dir);
+        return true;
+}
+
+void cache_evict(cache_t* cache)
+{
+        char path[PATH_MAX];
+        cache_entry_t* entries;
+        size_t count, capacity;
+        struct dirent* dirent;
+        off_t total, target;
+        time_t now;
+        DIR* dir;
+
+        dir = opendir(cache->dir);
+        if (dir == NULL) {
+                return;
+        }
+
+        entries = NULL;
+        count = 0;
+        capacity = 0;
+        total = 0;
+        now = time(NULL);
+        while ((dirent = readdir(dir)) != NULL) {
+                if (dirent->d_name[0] == '.') {
+                        continue;
+                }
+
+                if (snprintf(path, sizeof(path), "%s/%s", cache->dir, dirent->d_name) >= (int)sizeof(path)) {
+                        continue;
+                }
+
+                if (!collect_entries(path, now, &entries, &count, &capacity, &total)) {
+                        break;
+                }
+        }
+        closedir(dir);
+
+        /* Remove the least recently used entries until well under the limit */
+        if ((size_t)total > cache->max_size) {
+                debug("Evicting cache entries...");
+
+                target = (off_t)(cache->max_size / CACHE_TRIM_DEN * CACHE_TRIM_NUM);
+                qsort(entries, count, sizeof(cache_entry_t), compare_entries);
+                for (size_t i = 0; i < count && total > target; i++) {
+                        if (unlink(entries[i].path) == 0) {
+                                total -= entries[i].size;
+                        }
+                }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+                free(entries[i].path);
+        }
+        free(entries);
+}
+
+void cache_print_stats(cache_t* cache)
+{
+        fprintf(
+                log_stderr(),
+                "cache: %zu hit(s), %zu miss(es), %zu stored\n",
+                atomic_load(&cache->hits),
+                atomic_load(&cache->misses),
+                atomic_load(&cache->stores)
+        );
+}
+
+bool cache_init(cache_t* cache, char* dir, size_t max_size)
+{
+        debug("Initializing cache...");
+
+        /* Leave room for the subdirectory and key in every path */
+        if (strlen(dir) + SHA256_SIZE * 2 + 32 > PATH_MAX) {
+                errno = ENAMETOOLONG;
+                return false;
+        }
+
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+                return false;
+        }
+
+        pthread_once(&build_once, hash_build);
+
+        cache->dir = dir;
+        cache->max_size = max_size;
+        atomic_init(&cache->hits, 0);
+        atomic_init(&cache->misses, 0);
+        atomic_init(&cache->stores, 0);
+        return true;
+}
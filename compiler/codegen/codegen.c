@@ -4,28 +4,31 @@
  * Provided under the BSD 3-Clause license.
  */
 
+#include <stdlib.h>
 #include "codegen.h"
 #include "log.h"
+#include "pool.h"
+#include "trace.h"
 
 static char* arg_reg_bases[] = { "di", "si", "d", "c", "r8", "r9" };
 
-static void generate_arg_reg(int id, size_t bytes, FILE* fp)
+static void generate_arg_reg(int id, size_t bytes, emitter_t* emitter)
 {
         /* r[8-9][d|w|b]? */
         if (id >= 4) {
-                fputs(arg_reg_bases[id], fp);
+                emit_string(emitter, arg_reg_bases[id], 2);
 
                 switch (bytes) {
                 case 8:
                         break;
                 case 4:
-                        fputc('d', fp);
+                        emit_char(emitter, 'd');
                         break;
                 case 2:
-                        fputc('w', fp);
+                        emit_char(emitter, 'w');
                         break;
                 case 1:
-                        fputc('b', fp);
+                        emit_char(emitter, 'b');
                         break;
                 default:
                         break;
@@ -36,73 +39,176 @@ static void generate_arg_reg(int id, size_t bytes, FILE* fp)
 
         /* [r|e][di|si|dx|cx] */
         if (bytes == 8) {
-                fputc('r', fp);
+                emit_char(emitter, 'r');
         } else if (bytes == 4) {
-                fputc('e', fp);
+                emit_char(emitter, 'e');
         }
 
-        fputs(arg_reg_bases[id], fp);
+        emit_string(emitter, arg_reg_bases[id], id >= 2 ? 1 : 2);
 
         if (bytes == 1) {
                 /* [di|si|d|c]l */
-                fputc('l', fp);
+                emit_char(emitter, 'l');
         } if (id >= 2) {
                 /* [d|c]x */
-                fputc('x', fp);
+                emit_char(emitter, 'x');
         }
 }
 
-static void generate_call(ast_node_t* call, FILE* fp, size_t word_bytes)
+static void generate_call(ast_t* ast, ast_node_t* call, emitter_t* emitter, size_t word_bytes)
 {
-        fprintf(
-                fp,
-                "\tcall %.*s\n",
-                (int)call->callee->name.length, call->callee->name.string
-        );
+        ast_node_t* callee;
+
+        callee = get_node(ast, call->callee);
+        emit_literal(emitter, "\tcall ");
+        emit_name(emitter, &callee->name);
+        emit_char(emitter, '\n');
 }
 
-static void generate_statements(ast_node_t* parent, FILE* fp, size_t word_bytes)
+static void generate_statements(ast_t* ast, ast_node_t* parent, emitter_t* emitter, size_t word_bytes)
 {
-        for (ast_node_t* node = parent->children.head; node != NULL; node = node->next) {
+        ast_node_t* node;
+
+        for (node_id_t id = parent->children.head; id != NODE_NONE; id = node->next) {
+                node = get_node(ast, id);
                 if (node->kind == NK_CALL) {
-                        generate_call(node, fp, word_bytes);
+                        generate_call(ast, node, emitter, word_bytes);
                 }
         }
 }
 
-static void generate_procedure(ast_node_t* procedure, FILE* fp, size_t word_bytes)
+void codegen_procedure(ast_t* ast, ast_node_t* procedure, emitter_t* emitter, size_t word_bytes)
 {
-        fprintf(
-                fp,
-                "\t.globl %.*s\n"
-                "\t.type %.*s, %%function\n"
-                "%.*s:\n",
-                (int)procedure->name.length, procedure->name.string,
-                (int)procedure->name.length, procedure->name.string,
-                (int)procedure->name.length, procedure->name.string
-        );
-
-        generate_statements(procedure, fp, word_bytes);
-
-        fprintf(
-                fp,
-                "\t.size %.*s, .-%.*s\n",
-                (int)procedure->name.length, procedure->name.string, (int)procedure->name.length, procedure->name.string
-        );
+        trace_span_t span;
+
+        trace_begin(&span);
+        emit_literal(emitter, "\t.globl ");
+        emit_name(emitter, &procedure->name);
+        emit_literal(emitter, "\n\t.type ");
+        emit_name(emitter, &procedure->name);
+        emit_literal(emitter, ", %function\n");
+        emit_name(emitter, &procedure->name);
+        emit_literal(emitter, ":\n");
+
+        generate_statements(ast, procedure, emitter, word_bytes);
+
+        emit_literal(emitter, "\t.size ");
+        emit_name(emitter, &procedure->name);
+        emit_literal(emitter, ", .-");
+        emit_name(emitter, &procedure->name);
+        emit_char(emitter, '\n');
+
+        trace_end(&span, "codegen", procedure->name.string, procedure->name.length);
+}
+
+typedef struct {
+        ast_t* ast;
+        ast_node_t** definitions;
+        size_t n_definitions;
+        emitter_t* parts;
+        size_t word_bytes;
+        trace_t* trace;
+} codegen_job_t;
+
+static void generate_part(void* context, size_t index)
+{
+        codegen_job_t* job;
+        size_t end;
+
+        job = context;
+        trace_bind(job->trace);
+        end = (index + 1) * CODEGEN_PART_SIZE;
+        if (end > job->n_definitions) {
+                end = job->n_definitions;
+        }
+
+        for (size_t i = index * CODEGEN_PART_SIZE; i < end; i++) {
+                codegen_procedure(job->ast, job->definitions[i], &job->parts[index], job->word_bytes);
+        }
 }
 
-bool codegen(ast_node_t* procedures, FILE* fp, size_t word_bytes)
+static bool codegen_parallel(ast_t* ast, ast_node_t* procedures, emitter_t* emitter, size_t word_bytes, size_t n_threads, size_t n_definitions)
 {
+        codegen_job_t job;
+        ast_node_t* proc;
+        size_t n_parts, n_ready, i;
+        bool status;
+
+        job.ast = ast;
+        job.word_bytes = word_bytes;
+        job.trace = trace_current();
+        job.n_definitions = n_definitions;
+        job.definitions = malloc(n_definitions * sizeof(ast_node_t*));
+        n_parts = (n_definitions + CODEGEN_PART_SIZE - 1) / CODEGEN_PART_SIZE;
+        job.parts = malloc(n_parts * sizeof(emitter_t));
+        if (job.definitions == NULL || job.parts == NULL) {
+                free(job.definitions);
+                free(job.parts);
+                return false;
+        }
+
+        i = 0;
+        for (node_id_t id = procedures->children.head; id != NODE_NONE; id = proc->next) {
+                proc = get_node(ast, id);
+                if (proc->flags & NF_DEFINITION) {
+                        job.definitions[i++] = proc;
+                }
+        }
+
+        /* Parts are generated in any order, but joined in source order */
+        for (n_ready = 0; n_ready < n_parts; n_ready++) {
+                if (!emitter_init(&job.parts[n_ready], -1, CODEGEN_PART_BUFFER_SIZE)) {
+                        break;
+                }
+        }
+
+        status = n_ready == n_parts
+                && pool_run(n_threads, n_parts, generate_part, &job)
+                && emit_join(emitter, job.parts, n_parts);
+
+        for (i = 0; i < n_ready; i++) {
+                emitter_destroy(&job.parts[i]);
+        }
+        free(job.parts);
+        free(job.definitions);
+        return status;
+}
+
+void codegen_begin(emitter_t* emitter)
+{
+        emit_literal(emitter, "\t.text\n");
+}
+
+bool codegen(ast_t* ast, ast_node_t* procedures, emitter_t* emitter, size_t word_bytes, size_t n_threads)
+{
+        ast_node_t* proc;
+        size_t n_definitions;
+
         debug("Generating assembly code...");
 
-        fprintf(fp, "\t.text\n");
-        for (ast_node_t* proc = procedures->children.head; proc != NULL; proc = proc->next) {
+        codegen_begin(emitter);
+
+        /* Small modules are not worth handing to other threads */
+        n_definitions = 0;
+        for (node_id_t id = procedures->children.head; id != NODE_NONE; id = proc->next) {
+                proc = get_node(ast, id);
+                if (proc->flags & NF_DEFINITION) {
+                        n_definitions++;
+                }
+        }
+
+        if (n_threads > 1 && n_definitions > CODEGEN_PART_SIZE) {
+                return codegen_parallel(ast, procedures, emitter, word_bytes, n_threads, n_definitions);
+        }
+
+        for (node_id_t id = procedures->children.head; id != NODE_NONE; id = proc->next) {
+                proc = get_node(ast, id);
                 if (!(proc->flags & NF_DEFINITION)) {
                         continue;
                 }
 
-                generate_procedure(proc, fp, word_bytes);
+                codegen_procedure(ast, proc, emitter, word_bytes);
         }
 
-        return true;
+        return !emitter->failed;
 }
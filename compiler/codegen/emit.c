@@ -0,0 +1,162 @@
+/*
+ * Buffered assembly output.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "codegen/emit.h"
+#include "log.h"
+
+/* Parts written per writev() call */
+#define JOIN_BATCH 64
+
+bool emit_reserve(emitter_t* emitter, size_t length)
+{
+        size_t capacity;
+        char* data;
+
+        if (emitter->failed) {
+                return false;
+        }
+
+        /* Make room by writing out what is already there */
+        if (emitter->fd >= 0 && emitter->size > 0) {
+                if (!emit_flush(emitter)) {
+                        return false;
+                }
+
+                if (length <= emitter->capacity) {
+                        return true;
+                }
+        }
+
+        capacity = emitter->capacity;
+        while (capacity - emitter->size < length) {
+                capacity *= 2;
+        }
+
+        data = realloc(emitter->data, capacity);
+        if (data == NULL) {
+                emitter->failed = true;
+                return false;
+        }
+
+        emitter->data = data;
+        emitter->capacity = capacity;
+        return true;
+}
+
+/*
+ * Appends the contents of each part in order. With a file descriptor
+ * the parts are written straight from their own buffers.
+ */
+bool emit_join(emitter_t* emitter, emitter_t* parts, size_t n_parts)
+{
+        struct iovec iov[JOIN_BATCH];
+        size_t i, n_iov;
+        ssize_t result;
+
+        for (i = 0; i < n_parts; i++) {
+                if (parts[i].failed) {
+                        emitter->failed = true;
+                        return false;
+                }
+        }
+
+        if (emitter->fd < 0) {
+                for (i = 0; i < n_parts; i++) {
+                        emit_string(emitter, parts[i].data, parts[i].size);
+                }
+
+                return !emitter->failed;
+        }
+
+        if (!emit_flush(emitter)) {
+                return false;
+        }
+
+        i = 0;
+        while (i < n_parts) {
+                for (n_iov = 0; n_iov < JOIN_BATCH && i + n_iov < n_parts; n_iov++) {
+                        iov[n_iov].iov_base = parts[i + n_iov].data;
+                        iov[n_iov].iov_len = parts[i + n_iov].size;
+                }
+
+                result = writev(emitter->fd, iov, (int)n_iov);
+                if (result < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (result < 0) {
+                        emitter->failed = true;
+                        return false;
+                }
+
+                /* Skip what was written, finish a partial part by hand */
+                for (; n_iov > 0 && (size_t)result >= parts[i].size; n_iov--) {
+                        result -= (ssize_t)parts[i].size;
+                        parts[i++].size = 0;
+                }
+
+                if (result > 0) {
+                        memmove(parts[i].data, parts[i].data + result, parts[i].size - (size_t)result);
+                        parts[i].size -= (size_t)result;
+                }
+        }
+
+        return true;
+}
+
+bool emit_flush(emitter_t* emitter)
+{
+        size_t written;
+        ssize_t result;
+
+        if (emitter->failed) {
+                return false;
+        }
+
+        if (emitter->fd < 0) {
+                return true;
+        }
+
+        written = 0;
+        while (written < emitter->size) {
+                result = write(emitter->fd, emitter->data + written, emitter->size - written);
+                if (result < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+
+                        emitter->failed = true;
+                        return false;
+                }
+
+                written += (size_t)result;
+        }
+
+        emitter->size = 0;
+        return true;
+}
+
+void emitter_destroy(emitter_t* emitter)
+{
+        free(emitter->data);
+        emitter->data = NULL;
+        emitter->size = 0;
+        emitter->capacity = 0;
+}
+
+bool emitter_init(emitter_t* emitter, int fd, size_t capacity)
+{
+        emitter->fd = fd;
+        emitter->failed = false;
+        emitter->size = 0;
+        emitter->capacity = capacity;
+        emitter->data = malloc(capacity);
+
+        return emitter->data != NULL;
+}
@@ -0,0 +1,679 @@
+/*
+ * Compilation of a set of files.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cache.h"
+#include "codegen.h"
+#include "compile.h"
+#include "dump.h"
+#include "interface.h"
+#include "intern.h"
+#include "parser.h"
+#include "log.h"
+#include "pool.h"
+#include "report.h"
+#include "source.h"
+#include "trace.h"
+
+static const char* emit_kind_strings[] = {
+        [EMIT_ASM] = "asm",
+        [EMIT_TOKENS] = "tokens",
+        [EMIT_AST] = "ast",
+        [EMIT_INTERFACE] = "interface"
+};
+
+static const char* value_options[] = { "-i", "-o", "-j", "--cache-dir", "--cache-size", "--import", "--report-json" };
+
+static bool parse_args(session_t* session, int argc, char* argv[])
+{
+        size_t n_inputs, n_outputs;
+        char* end;
+
+        /* Every input needs at least two arguments */
+        session->jobs = calloc((size_t)argc / 2 + 1, sizeof(job_t));
+        session->import_filenames = calloc((size_t)argc / 2 + 1, sizeof(char*));
+        if (session->jobs == NULL || session->import_filenames == NULL) {
+                return false;
+        }
+
+        n_inputs = 0;
+        n_outputs = 0;
+        for (int i = 1; i < argc; i++) {
+                bool found;
+
+                if (strcmp(argv[i], "--cache-stats") == 0) {
+                        session->cache_stats = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "--emit-interface") == 0) {
+                        session->emit_kind = EMIT_INTERFACE;
+                        continue;
+                }
+
+                if (strncmp(argv[i], "--emit=", 7) == 0) {
+                        found = false;
+                        for (size_t j = 0; j < sizeof(emit_kind_strings) / sizeof(emit_kind_strings[0]); j++) {
+                                if (strcmp(argv[i] + 7, emit_kind_strings[j]) == 0) {
+                                        session->emit_kind = (emit_kind_t)j;
+                                        found = true;
+                                        break;
+                                }
+                        }
+
+                        if (!found) {
+                                fprintf(log_stderr(), "Invalid output kind \"%s\"\n", argv[i] + 7);
+                                return false;
+                        }
+
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-flex-only") == 0) {
+                        session->lex_only = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-fsyntax-only") == 0) {
+                        session->syntax_only = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-fstream-input") == 0) {
+                        session->stream_inputs = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-flex-thread") == 0) {
+                        session->lex_thread = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-ftime-report") == 0) {
+                        session->time_report = true;
+                        continue;
+                }
+
+                if (strcmp(argv[i], "-fmem-report") == 0) {
+                        session->mem_report = true;
+                        continue;
+                }
+
+                if (strncmp(argv[i], "--trace=", 8) == 0) {
+                        session->trace_filename = argv[i] + 8;
+                        continue;
+                }
+
+                found = false;
+                for (size_t j = 0; j < sizeof(value_options) / sizeof(value_options[0]); j++) {
+                        if (strcmp(argv[i], value_options[j]) == 0) {
+                                found = true;
+                                break;
+                        }
+                }
+
+                if (!found) {
+                        fprintf(log_stderr(), "Invalid argument \"%s\"\n", argv[i]);
+                        return false;
+                }
+
+                if (i + 1 >= argc) {
+                        fprintf(log_stderr(), "Expected a value after %s\n", argv[i]);
+                        return false;
+                }
+
+                /* The nth -o is the output for the nth -i */
+                if (strcmp(argv[i], "-i") == 0) {
+                        session->jobs[n_inputs++].input_filename = argv[++i];
+                } else if (strcmp(argv[i], "-o") == 0) {
+                        session->jobs[n_outputs++].output_filename = argv[++i];
+                } else if (strcmp(argv[i], "-j") == 0) {
+                        session->n_threads = strtoul(argv[++i], &end, 10);
+                        if (*end != '\0' || session->n_threads == 0) {
+                                fprintf(log_stderr(), "Invalid thread count \"%s\"\n", argv[i]);
+                                return false;
+                        }
+                } else if (strcmp(argv[i], "--cache-dir") == 0) {
+                        session->cache_dir = argv[++i];
+                } else if (strcmp(argv[i], "--import") == 0) {
+                        session->import_filenames[session->n_imports++] = argv[++i];
+                } else if (strcmp(argv[i], "--report-json") == 0) {
+                        session->report_filename = argv[++i];
+                } else {
+                        /* Given in MiB */
+                        session->cache_size = strtoul(argv[++i], &end, 10) * 1024 * 1024;
+                        if (*end != '\0' || session->cache_size == 0) {
+                                fprintf(log_stderr(), "Invalid cache size \"%s\"\n", argv[i]);
+                                return false;
+                        }
+                }
+        }
+
+        /* Stopping early writes nothing, so outputs are optional */
+        if (n_inputs == 0 || (n_inputs != n_outputs && !session->lex_only && !session->syntax_only)) {
+                fprintf(log_stderr(), "Each input filename (-i) needs an output filename (-o)\n");
+                return false;
+        }
+
+        /* Only assembly and interfaces are worth caching */
+        if (session->lex_only || session->syntax_only || session->emit_kind == EMIT_TOKENS || session->emit_kind == EMIT_AST) {
+                session->cache_dir = NULL;
+        }
+
+        session->n_jobs = n_inputs;
+        return true;
+}
+
+typedef struct {
+        emitter_t output;
+        report_t* report;
+        report_clock_t* clock;
+} codegen_stream_t;
+
+static bool open_output(emitter_t* output, const char* output_filename)
+{
+        int output_fd;
+
+        output_fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0) {
+                log_errno(output_filename);
+                return false;
+        }
+
+        if (!emitter_init(output, output_fd, EMIT_BUFFER_SIZE)) {
+                fprintf(log_stderr(), "Failed to allocate output buffer\n");
+                close(output_fd);
+                return false;
+        }
+
+        return true;
+}
+
+static bool close_output(emitter_t* output, const char* output_filename, bool status)
+{
+        int output_fd;
+
+        status = status && emit_flush(output);
+        if (!status) {
+                log_errno(output_filename);
+        }
+
+        output_fd = output->fd;
+        emitter_destroy(output);
+        close(output_fd);
+        return status;
+}
+
+static bool generate_output(parser_t* parser, const char* output_filename, size_t n_codegen_threads, report_t* report, report_clock_t* clock)
+{
+        emitter_t output;
+        bool status;
+
+        if (!open_output(&output, output_filename)) {
+                return false;
+        }
+
+        /* Output that overflows the buffer is written during code generation */
+        status = codegen(&parser->ast, parser->procedures, &output, sizeof(void*), n_codegen_threads);
+        if (report != NULL) {
+                report_phase(report, PHASE_CODEGEN, clock);
+        }
+
+        status = close_output(&output, output_filename, status);
+        if (report != NULL) {
+                report_phase(report, PHASE_OUTPUT, clock);
+        }
+
+        return status;
+}
+
+static void generate_definition(void* context, ast_t* ast, ast_node_t* procedure, node_id_t body)
+{
+        codegen_stream_t* stream;
+
+        stream = context;
+        if (stream->report != NULL) {
+                report_phase(stream->report, PHASE_PARSE, stream->clock);
+        }
+
+        codegen_procedure(ast, procedure, &stream->output, sizeof(void*));
+
+        /* The body is released as soon as this returns */
+        if (stream->report != NULL) {
+                report_count_nodes(stream->report, ast, first_deletable(ast, body));
+                report_phase(stream->report, PHASE_CODEGEN, stream->clock);
+        }
+}
+
+static bool stream_output(parser_t* parser, const char* output_filename, bool* parsed, report_t* report, report_clock_t* clock)
+{
+        codegen_stream_t stream;
+        bool status;
+
+        if (!open_output(&stream.output, output_filename)) {
+                return false;
+        }
+
+        /* Each definition is generated and freed as soon as it is parsed */
+        stream.report = report;
+        stream.clock = clock;
+        parser->on_definition = generate_definition;
+        parser->definition_context = &stream;
+        codegen_begin(&stream.output);
+        *parsed = parser_parse(parser);
+        parser->on_definition = NULL;
+
+        if (report != NULL) {
+                report_phase(report, PHASE_PARSE, clock);
+                report_count_nodes(report, &parser->ast, 1);
+        }
+
+        status = close_output(&stream.output, output_filename, !stream.output.failed);
+        if (report != NULL) {
+                report_phase(report, PHASE_OUTPUT, clock);
+        }
+
+        return status;
+}
+
+static bool generate_interface(parser_t* parser, const char* input_filename, source_t* input, const char* output_filename)
+{
+        char source_path[PATH_MAX];
+        int output_fd;
+        bool status;
+
+        /* Interfaces are checked against the source they came from */
+        if (input->data == NULL) {
+                fprintf(log_stderr(), "%s: Interfaces can only be made from source files\n", input_filename);
+                return false;
+        }
+
+        /* Importers may be anywhere, so the source is named in full */
+        if (realpath(input_filename, source_path) == NULL) {
+                log_errno(input_filename);
+                return false;
+        }
+
+        output_fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0) {
+                log_errno(output_filename);
+                return false;
+        }
+
+        status = interface_write(&parser->ast, parser->types, parser->procedures, source_path, input->data, input->size, output_fd);
+        if (!status) {
+                log_errno(output_filename);
+        }
+
+        close(output_fd);
+        return status;
+}
+
+static bool generate_dump(session_t* session, parser_t* parser, const char* output_filename)
+{
+        FILE* output;
+        bool status;
+
+        output = fopen(output_filename, "w");
+        if (output == NULL) {
+                log_errno(output_filename);
+                return false;
+        }
+
+        if (session->emit_kind == EMIT_TOKENS) {
+                dump_tokens(output, &parser->tokens);
+        } else {
+                dump_tree(output, &parser->ast, parser->types);
+                dump_tree(output, &parser->ast, parser->procedures);
+        }
+
+        status = !ferror(output);
+        status = fclose(output) == 0 && status;
+        if (!status) {
+                log_errno(output_filename);
+        }
+
+        return status;
+}
+
+/* Threads not needed for other files help with lexing and code generation */
+static size_t spare_threads(session_t* session)
+{
+        return session->n_threads > session->n_jobs ? session->n_threads / session->n_jobs : 1;
+}
+
+/* Whether each procedure is generated as soon as it is parsed */
+static bool streams_output(session_t* session)
+{
+        /* Splitting code generation between threads needs the whole tree */
+        return !session->syntax_only && session->emit_kind == EMIT_ASM && spare_threads(session) == 1;
+}
+
+static bool parse_and_generate(session_t* session, parser_t* parser, job_t* job, source_t* input, bool* parsed, report_t* report, report_clock_t* clock)
+{
+        size_t n_codegen_threads;
+
+        parser->imports = session->imports;
+        parser->n_imports = session->n_imports;
+
+        n_codegen_threads = spare_threads(session);
+        if (streams_output(session)) {
+                return stream_output(parser, job->output_filename, parsed, report, clock);
+        }
+
+        *parsed = parser_parse(parser);
+        if (report != NULL) {
+                report_phase(report, PHASE_PARSE, clock);
+                report_count_nodes(report, &parser->ast, 1);
+        }
+
+        if (session->syntax_only) {
+                return *parsed;
+        }
+
+        if (session->emit_kind == EMIT_AST) {
+                return generate_dump(session, parser, job->output_filename);
+        }
+
+        if (session->emit_kind == EMIT_INTERFACE) {
+                return generate_interface(parser, job->input_filename, input, job->output_filename);
+        }
+
+        return generate_output(parser, job->output_filename, n_codegen_threads, report, clock);
+}
+
+/* Interfaces name the file they were made from, so it is part of their key */
+static void job_options(session_t* session, const char* filename, uint8_t options[SHA256_SIZE])
+{
+        char path[PATH_MAX];
+        sha256_t ctx;
+
+        if (session->emit_kind != EMIT_INTERFACE) {
+                memcpy(options, session->cache_options, SHA256_SIZE);
+                return;
+        }
+
+        /* Without a full path there is no interface to store either */
+        if (realpath(filename, path) == NULL) {
+                snprintf(path, sizeof(path), "%s", filename);
+        }
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, session->cache_options, SHA256_SIZE);
+        sha256_update(&ctx, path, strlen(path));
+        sha256_final(&ctx, options);
+}
+
+/* Streamed sources are counted a window at a time, since they are never whole */
+static void count_window(void* context, const char* data, size_t size)
+{
+        report_count_source(context, data, size);
+}
+
+static void compile_job(session_t* session, job_t* job)
+{
+        report_t file_report;
+        uint8_t options[SHA256_SIZE];
+        report_clock_t clock;
+        interner_t interner;
+        report_t* report;
+        cache_key_t key;
+        parser_t parser;
+        source_t input;
+        bool parsed, lexed;
+        int stream_fd;
+
+        job->status = false;
+
+        /* Phase spans in a trace come from the report's clock */
+        report = NULL;
+        if (session->time_report || session->mem_report || session->report_filename != NULL || session->trace_filename != NULL) {
+                report = &file_report;
+                report_begin(report);
+                report_start(&clock);
+        }
+
+        /* Names from this file are interned separately from other threads */
+        if (!interner_init(&interner)) {
+                fprintf(log_stderr(), "Failed to initialize interner\n");
+                return;
+        }
+
+        /* Streamed input is never whole in memory, so it skips the cache */
+        stream_fd = source_open_stream(job->input_filename, session->stream_inputs);
+        if (stream_fd >= 0) {
+                memset(&input, 0, sizeof(source_t));
+                lexed = parser_init_stream(&parser, job->input_filename, stream_fd, report != NULL ? count_window : NULL, report);
+        } else {
+                if (!source_load(&input, job->input_filename)) {
+                        log_errno(job->input_filename);
+                        interner_destroy(&interner);
+                        return;
+                }
+
+                if (report != NULL) {
+                        report_count_source(report, input.data, input.size);
+                        report_phase(report, PHASE_LOAD, &clock);
+                }
+
+                /* Unchanged sources skip straight to the stored output */
+                if (session->cache_dir != NULL) {
+                        job_options(session, job->input_filename, options);
+                        cache_key(&key, options, input.data, input.size);
+                        if (cache_fetch(&session->cache, &key, job->output_filename)) {
+                                job->status = true;
+                                source_unload(&input);
+                                interner_destroy(&interner);
+                                if (report != NULL) {
+                                        report_phase(report, PHASE_OUTPUT, &clock);
+                                        report_end(&session->summary, report);
+                                }
+
+                                return;
+                        }
+                }
+
+                if (session->lex_thread && !session->lex_only && session->emit_kind != EMIT_TOKENS) {
+                        lexed = parser_init_piped(&parser, job->input_filename, input.data);
+                } else if (!session->lex_only && streams_output(session)) {
+                        /* Nothing looks back past a generated procedure, so its tokens need not stay */
+                        lexed = parser_init_lazy(&parser, job->input_filename, input.data);
+                } else {
+                        lexed = parser_init(&parser, job->input_filename, input.data, input.size, spare_threads(session));
+                }
+        }
+
+        /* Streams are otherwise only lexed as the parser gets to them */
+        if (lexed && session->lex_only && !tokens_finish(&parser.tokens)) {
+                parser_destory(&parser);
+                lexed = false;
+        }
+
+        if (!lexed) {
+                fprintf(log_stderr(), "Failed to lex %s\n", job->input_filename);
+                source_unload(&input);
+                interner_destroy(&interner);
+                return;
+        }
+
+        if (report != NULL) {
+                report_phase(report, PHASE_LEX, &clock);
+        }
+
+        parsed = false;
+        if (session->lex_only) {
+                job->status = true;
+        } else if (session->emit_kind == EMIT_TOKENS) {
+                job->status = generate_dump(session, &parser, job->output_filename);
+        } else {
+                job->status = parse_and_generate(session, &parser, job, &input, &parsed, report, &clock);
+        }
+
+        /* Tokens are still coming if parsing stopped early */
+        if (!tokens_finish(&parser.tokens)) {
+                fprintf(log_stderr(), "Failed to lex %s\n", job->input_filename);
+                job->status = false;
+        }
+
+        if (report != NULL) {
+                report_count_tokens(report, &parser.tokens);
+        }
+
+        /* Only clean compiles are cached, so errors are always reported */
+        if (session->cache_dir != NULL && input.data != NULL && parsed && job->status) {
+                cache_store(&session->cache, &key, job->output_filename);
+        }
+
+        parser_destory(&parser);
+        source_unload(&input);
+        interner_destroy(&interner);
+        if (report != NULL) {
+                report_phase(report, PHASE_OUTPUT, &clock);
+                report_end(&session->summary, report);
+        }
+}
+
+static void compile_file(void* context, size_t index)
+{
+        session_t* session;
+        trace_span_t span;
+        job_t* job;
+
+        session = context;
+        job = &session->jobs[index];
+
+        /* Pool threads report to whoever asked for the compile */
+        log_redirect(session->out, session->err);
+        trace_bind(session->trace_filename != NULL ? &session->trace : NULL);
+
+        trace_begin(&span);
+        compile_job(session, job);
+        trace_end(&span, "file", job->input_filename, strlen(job->input_filename));
+}
+
+static bool load_imports(session_t* session)
+{
+        import_loader_t load;
+
+        session->imports = calloc(session->n_imports + 1, sizeof(interface_t));
+        if (session->imports == NULL) {
+                return false;
+        }
+
+        load = session->load_import != NULL ? session->load_import : interface_load;
+        for (size_t i = 0; i < session->n_imports; i++) {
+                if (!load(&session->imports[i], session->import_filenames[i])) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/* Everything besides the compiler and the source that changes the output */
+static void hash_options(session_t* session)
+{
+        uint8_t word_bytes, mode;
+        sha256_t ctx;
+
+        /* Imports are identified by the source they were made from */
+        word_bytes = sizeof(void*);
+        mode = session->emit_kind;
+        sha256_init(&ctx);
+        sha256_update(&ctx, &word_bytes, sizeof(word_bytes));
+        sha256_update(&ctx, &mode, sizeof(mode));
+        for (size_t i = 0; i < session->n_imports; i++) {
+                sha256_update(&ctx, session->imports[i].header->source_hash, SHA256_SIZE);
+        }
+        sha256_final(&ctx, session->cache_options);
+}
+
+bool session_run(session_t* session)
+{
+        bool status;
+
+        if (!load_imports(session)) {
+                return false;
+        }
+
+        if (session->cache_dir != NULL) {
+                if (!cache_init(&session->cache, session->cache_dir, session->cache_size)) {
+                        log_errno(session->cache_dir);
+                        return false;
+                }
+
+                hash_options(session);
+        }
+
+        if (session->trace_filename != NULL) {
+                trace_init(&session->trace);
+        }
+
+        report_init(&session->summary);
+        status = pool_run(session->n_threads, session->n_jobs, compile_file, session);
+        for (size_t i = 0; i < session->n_jobs; i++) {
+                status = status && session->jobs[i].status;
+        }
+
+        if (session->cache_dir != NULL) {
+                if (atomic_load(&session->cache.stores) > 0) {
+                        cache_evict(&session->cache);
+                }
+
+                if (session->cache_stats) {
+                        cache_print_stats(&session->cache);
+                }
+        }
+
+        report_print(&session->summary, session->time_report, session->mem_report);
+        if (session->report_filename != NULL && !report_write_json(&session->summary, session->report_filename)) {
+                log_errno(session->report_filename);
+                status = false;
+        }
+
+        if (session->trace_filename != NULL) {
+                if (!trace_write(&session->trace, session->trace_filename)) {
+                        log_errno(session->trace_filename);
+                        status = false;
+                }
+
+                trace_bind(NULL);
+                trace_destroy(&session->trace);
+        }
+
+        report_destroy(&session->summary);
+        return status;
+}
+
+void session_destroy(session_t* session)
+{
+        /* Shared imports belong to whoever loaded them */
+        if (session->imports != NULL && session->load_import == NULL) {
+                for (size_t i = 0; i < session->n_imports; i++) {
+                        interface_unload(&session->imports[i]);
+                }
+        }
+
+        free(session->imports);
+        free(session->import_filenames);
+        free(session->jobs);
+}
+
+bool session_init(session_t* session, int argc, char* argv[])
+{
+        memset(session, 0, sizeof(session_t));
+        session->n_threads = 1;
+        session->cache_size = CACHE_DEFAULT_SIZE;
+        session->emit_kind = EMIT_ASM;
+
+        return parse_args(session, argc, argv);
+}
@@ -0,0 +1,9 @@
+/*
+ * Event counters for compile reports.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include "counters.h"
+
+_Thread_local counters_t counters;
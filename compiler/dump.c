@@ -0,0 +1,170 @@
+/*
+ * Human-readable dumps of compiler stages.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <stdio.h>
+#include "dump.h"
+
+static const char* token_kind_strings[TK_COUNT] = {
+        [TK_UNKNOWN] = "unknown",
+        [TK_EOF] = "eof",
+        [TK_IDENTIFIER] = "identifier",
+        [TK_STRING] = "string",
+        [TK_NUMBER] = "number",
+        [TK_CHARACTER] = "character",
+        [TK_COMMA] = "comma",
+        [TK_DOT] = "dot",
+        [TK_COLON] = "colon",
+        [TK_SEMICOLON] = "semicolon",
+        [TK_LPAREN] = "lparen",
+        [TK_RPAREN] = "rparen",
+        [TK_LCURLY] = "lcurly",
+        [TK_RCURLY] = "rcurly",
+        [TK_LSQUARE] = "lsquare",
+        [TK_RSQUARE] = "rsquare",
+        [TK_ARROW] = "arrow",
+        [TK_INCREMENT] = "increment",
+        [TK_DECREMENT] = "decrement",
+        [TK_PLUS] = "plus",
+        [TK_MINUS] = "minus",
+        [TK_STAR] = "star",
+        [TK_SLASH] = "slash",
+        [TK_PERCENT] = "percent",
+        [TK_EQUALS] = "equals",
+        [TK_EXCLAMATION] = "exclamation",
+        [TK_LESS_THAN] = "less than",
+        [TK_GREATER_THAN] = "greater than",
+        [TK_CARET] = "caret",
+        [TK_AMPERSAND] = "ampersand",
+        [TK_PIPE] = "pipe",
+        [TK_TILDE] = "tilde",
+        [TK_PUB] = "pub",
+        [TK_TYPE] = "type",
+        [TK_STRUCT] = "struct",
+        [TK_PROC] = "proc",
+        [TK_RETURN] = "return",
+        [TK_IF] = "if"
+};
+
+void dump_tokens(FILE* file, token_stream_t* tokens)
+{
+        int line, column;
+        size_t i;
+
+        /* Tokens that are lexed as they are needed are dropped once printed */
+        for (token_id_t id = 0; tokens_have(tokens, id); id++) {
+                tokens_drop(tokens, id);
+                i = token_index(tokens, id);
+                token_location(tokens, id, &line, &column);
+                fprintf(file, "%d:%d: %s", line, column, token_kind_strings[tokens->kinds[i]]);
+                if (tokens->flags[i] & TF_ASSIGNMENT) {
+                        fprintf(file, " (assignment)");
+                }
+
+                if (tokens->kinds[i] == TK_NUMBER) {
+                        fprintf(file, " 0x%lx\n", tokens->values[i]);
+                } else if (tokens->kinds[i] == TK_IDENTIFIER || tokens->kinds[i] >= TK_PUB) {
+                        name_t name;
+
+                        /* Names outlive streamed sources */
+                        token_name(tokens, id, &name);
+                        fprintf(file, " \"%.*s\"\n", (int)name.length, name.string);
+                } else if (tokens->lengths[i] != 0 && tokens->source != NULL) {
+                        fprintf(file, " \"%.*s\"\n", (int)tokens->lengths[i], token_pos(tokens, id));
+                } else {
+                        fprintf(file, "\n");
+                }
+        }
+}
+
+static void print_node(FILE* file, ast_t* ast, ast_node_t* node)
+{
+        ast_node_t* type;
+        ast_node_t* variable;
+
+        if (node->flags & NF_PUBLIC) {
+                fprintf(file, "public ");
+        }
+
+        switch (node->kind) {
+        case NK_BUILTIN_TYPE:
+        case NK_TYPE_ALIAS:
+                fprintf(file, "type %.*s: %u byte(s), pointer depth %u\n", (int)node->name.length, node->name.string, node->bytes, node->ptr_depth);
+                break;
+        case NK_STRUCT:
+                fprintf(file, "type %.*s: struct {\n", (int)node->name.length, node->name.string);
+                break;
+        case NK_STRUCT_MEMBER:
+        case NK_LOCAL_VARIABLE:
+                type = get_node(ast, node->type);
+                fprintf(file, "%.*s %.*s;\n", (int)type->name.length, type->name.string, (int)node->name.length, node->name.string);
+                break;
+        case NK_PROCEDURE:
+                fprintf(file, "proc %.*s()", (int)node->name.length, node->name.string);
+                if (node->type != NODE_NONE) {
+                        type = get_node(ast, node->type);
+                        fprintf(file, " -> %.*s", (int)type->name.length, type->name.string);
+                }
+                fprintf(file, " {\n");
+                break;
+        case NK_PARAMETER:
+                type = get_node(ast, node->type);
+                fprintf(file, "%.*s %.*s; (parameter)\n", (int)type->name.length, type->name.string, (int)node->name.length, node->name.string);
+                break;
+        case NK_CALL:
+                variable = get_node(ast, node->callee);
+                fprintf(file, "%.*s();\n", (int)variable->name.length, variable->name.string);
+                break;
+        case NK_NUMBER:
+                fprintf(file, "0x%lx\n", node->value);
+                break;
+        case NK_VARIABLE_REFERENCE:
+                variable = get_node(ast, node->variable);
+                fprintf(file, "%.*s\n", (int)variable->name.length, variable->name.string);
+                break;
+        default:
+                fprintf(file, "%s\n", node_kind_strings[node->kind]);
+                break;
+        }
+}
+
+void dump_tree(FILE* file, ast_t* ast, ast_node_t* root)
+{
+        ast_node_t* node;
+        int indent;
+
+        if (root->children.head == NODE_NONE) {
+                return;
+        }
+
+        /* Nodes are in preorder, so this walks forward through the pool */
+        node = get_node(ast, root->children.head);
+        indent = 0;
+        for (;;) {
+                fprintf(file, "%*s", indent, "");
+                print_node(file, ast, node);
+
+                if (node->children.head != NODE_NONE) {
+                        node = get_node(ast, node->children.head);
+                        indent += 4;
+                        continue;
+                }
+
+                /* Climb until there is a sibling to go to */
+                while (node->next == NODE_NONE) {
+                        node = get_node(ast, node->parent);
+                        if (node == root) {
+                                return;
+                        }
+
+                        indent -= 4;
+                        if (node->kind == NK_PROCEDURE || node->kind == NK_STRUCT) {
+                                fprintf(file, "%*s}\n", indent, "");
+                        }
+                }
+
+                node = get_node(ast, node->next);
+        }
+}
@@ -1,33 +1,37 @@
 /*
- * FNV-1a hash function.
+ * Word-at-a-time hash function.
  * Copyright (c) 2023-2024, Quinn Stephens.
  * Provided under the BSD 3-Clause license.
  */
 
+#include <string.h>
 #include "hash.h"
 
-hash_t hash_data(void* data, size_t length)
+hash_t hash_data(const void* data, size_t length)
 {
+        const uint8_t* bytes;
         hash_t hash;
+        uint64_t word;
 
-        hash = FNV_OFFSET_BASIS;
-        for (size_t i = 0; i < length; i++) {
-                hash ^= ((uint8_t*)data)[i];
-                hash *= FNV_PRIME;
+        bytes = data;
+        hash = HASH_SEED ^ (length * HASH_MUL);
+        for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+                memcpy(&word, bytes, sizeof(uint64_t));
+                hash = hash_mix(hash, word);
+                bytes += sizeof(uint64_t);
         }
 
-        return hash;
+        /* Zero-extend the last partial word */
+        if (length > 0) {
+                word = 0;
+                memcpy(&word, bytes, length);
+                hash = hash_mix(hash, word);
+        }
+
+        return hash_finish(hash);
 }
 
-hash_t hash_string(char *str)
+hash_t hash_string(const char* str)
 {
-        hash_t hash;
-
-        hash = FNV_OFFSET_BASIS;
-        while (*str) {
-                hash ^= (uint8_t)*str++;
-                hash *= FNV_PRIME;
-        }
-
-        return hash;
+        return hash_data(str, strlen(str));
 }
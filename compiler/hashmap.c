@@ -5,38 +5,131 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "counters.h"
 #include "hashmap.h"
 #include "log.h"
 
-void hashmap_remove(hashmap_entry_t *entry)
+static inline hash_t slot_hash(hash_t hash)
 {
-        list_remove(&entry->list_entry);
+        /* Keep real hashes out of the empty marker */
+        return hash != HASHMAP_EMPTY ? hash : 1;
 }
 
-void hashmap_add(list_entry_t *rows, hashmap_entry_t *entry, size_t n_rows)
+static hashmap_slot_t *alloc_slots(hashmap_t *map, size_t capacity)
 {
-        list_prepend(&rows[entry->hash % n_rows], &entry->list_entry);
+        hashmap_slot_t *slots;
+
+        if (map->arena != NULL) {
+                slots = arena_alloc(map->arena, capacity * sizeof(hashmap_slot_t));
+        } else {
+                slots = malloc(capacity * sizeof(hashmap_slot_t));
+        }
+
+        if (slots != NULL) {
+                memset(slots, 0, capacity * sizeof(hashmap_slot_t));
+        }
+
+        return slots;
+}
+
+static void insert_slot(hashmap_t *map, hashmap_slot_t *slot)
+{
+        size_t mask, i;
+
+        mask = map->capacity - 1;
+        for (i = slot->hash & mask; map->slots[i].hash != HASHMAP_EMPTY; i = (i + 1) & mask);
+        map->slots[i] = *slot;
 }
 
-hashmap_entry_t *hashmap_find(list_entry_t *rows, hash_t hash, size_t n_rows)
+static bool grow(hashmap_t *map)
 {
-        hashmap_entry_t *head, *entry;
+        hashmap_slot_t *old_slots;
+        size_t old_capacity;
 
-        entry = head = (hashmap_entry_t *)rows[hash % n_rows].next;
-        do {
-                if (entry->hash == hash) {
-                        return entry;
+        old_slots = map->slots;
+        old_capacity = map->capacity;
+
+        map->slots = alloc_slots(map, old_capacity * 2);
+        if (map->slots == NULL) {
+                map->slots = old_slots;
+                return false;
+        }
+        map->capacity = old_capacity * 2;
+
+        /* Rehash using the stored hashes */
+        for (size_t i = 0; i < old_capacity; i++) {
+                if (old_slots[i].hash != HASHMAP_EMPTY) {
+                        insert_slot(map, &old_slots[i]);
                 }
+        }
 
-                entry = (hashmap_entry_t *)entry->list_entry.next;
-        } while (entry != head);
+        if (map->arena == NULL) {
+                free(old_slots);
+        }
+
+        return true;
+}
+
+bool hashmap_add(hashmap_t *map, const char *key, size_t length, hash_t hash, void *value)
+{
+        hashmap_slot_t slot;
+
+        if ((map->count + 1) * HASHMAP_LOAD_DEN > map->capacity * HASHMAP_LOAD_NUM && !grow(map)) {
+                return false;
+        }
+
+        slot.hash = slot_hash(hash);
+        slot.length = (uint32_t)length;
+        slot.key = key;
+        slot.value = value;
+        insert_slot(map, &slot);
+        map->count++;
+
+        return true;
+}
+
+void *hashmap_find(hashmap_t *map, const char *key, size_t length, hash_t hash)
+{
+        hashmap_slot_t *slot;
+        size_t mask, i;
+
+        hash = slot_hash(hash);
+        mask = map->capacity - 1;
+        counters.hashmap_lookups++;
+        for (i = hash & mask; (slot = &map->slots[i])->hash != HASHMAP_EMPTY; i = (i + 1) & mask) {
+                counters.hashmap_probes++;
+                if (slot->hash == hash && slot->length == length && memcmp(slot->key, key, length) == 0) {
+                        return slot->value;
+                }
+        }
 
         return NULL;
 }
 
-void hashmap_init(list_entry_t *rows, size_t n_rows)
+void hashmap_destroy(hashmap_t *map)
+{
+        if (map->arena == NULL) {
+                free(map->slots);
+        }
+
+        map->slots = NULL;
+        map->capacity = 0;
+        map->count = 0;
+}
+
+bool hashmap_init(hashmap_t *map, size_t capacity, arena_t *arena)
 {
-        for (size_t r = 0; r < n_rows; r++) {
-                list_init(&rows[r]);
+        /* Capacity must be a power of two */
+        map->capacity = 1;
+        while (map->capacity < capacity) {
+                map->capacity <<= 1;
         }
+
+        map->count = 0;
+        map->arena = arena;
+        map->slots = alloc_slots(map, map->capacity);
+
+        return map->slots != NULL;
 }
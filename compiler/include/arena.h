@@ -0,0 +1,32 @@
+/*
+ * Arena (bump) allocator.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE  (64 * 1024)
+#define ARENA_ALIGNMENT   16
+
+typedef struct arena_chunk {
+        struct arena_chunk* prev;
+        char* end;
+        char data[];
+} arena_chunk_t;
+
+typedef struct {
+        arena_chunk_t* chunk;
+        char* pos;
+} arena_t;
+
+void* arena_alloc(arena_t* arena, size_t size);
+void arena_rewind(arena_t* arena, void* mark);
+void arena_destroy(arena_t* arena);
+void arena_keep_chunks(size_t max);
+void arena_init(arena_t* arena);
+
+#endif /* !_ARENA_H */
@@ -0,0 +1,52 @@
+/*
+ * Content-addressed output cache.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+#define CACHE_DEFAULT_SIZE (256 * 1024 * 1024)
+
+/* Eviction trims the cache to this fraction of its limit */
+#define CACHE_TRIM_NUM 3
+#define CACHE_TRIM_DEN 4
+
+/* Temporary files this old were left by a store that never finished */
+#define CACHE_TEMP_MAX_AGE (60 * 60)
+
+typedef struct {
+        uint8_t digest[SHA256_SIZE];
+} cache_key_t;
+
+/*
+ * Outputs are stored as <dir>/<first byte>/<rest of key>, keyed on a
+ * hash of the compiler binary, options that affect output and the
+ * source bytes. Entries are written to a temporary file and renamed
+ * into place, so readers never see a partial entry.
+ */
+typedef struct {
+        char* dir;
+        size_t max_size;
+
+        atomic_size_t hits;
+        atomic_size_t misses;
+        atomic_size_t stores;
+} cache_t;
+
+/* options is a digest of everything besides the source that changes the output */
+void cache_key(cache_key_t* key, const uint8_t options[SHA256_SIZE], const char* source, size_t size);
+bool cache_fetch(cache_t* cache, cache_key_t* key, const char* output_filename);
+bool cache_store(cache_t* cache, cache_key_t* key, const char* output_filename);
+void cache_evict(cache_t* cache);
+void cache_print_stats(cache_t* cache);
+bool cache_init(cache_t* cache, char* dir, size_t max_size);
+
+#endif /* !_CACHE_H */
@@ -8,9 +8,16 @@
 #define _CODEGEN_H
 
 #include <stdbool.h>
-#include <stdio.h>
+#include "codegen/emit.h"
 #include "parser/ast.h"
 
-bool codegen(ast_node_t* procedures, FILE* fp, size_t word_bytes);
+/* Procedures per buffer when generating on several threads */
+#define CODEGEN_PART_SIZE        256
+#define CODEGEN_PART_BUFFER_SIZE (16 * 1024)
+
+/* One procedure at a time, after codegen_begin() */
+void codegen_procedure(ast_t* ast, ast_node_t* procedure, emitter_t* emitter, size_t word_bytes);
+void codegen_begin(emitter_t* emitter);
+bool codegen(ast_t* ast, ast_node_t* procedures, emitter_t* emitter, size_t word_bytes, size_t n_threads);
 
 #endif /* !_CODEGEN_H */
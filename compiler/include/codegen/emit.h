@@ -0,0 +1,64 @@
+/*
+ * Buffered assembly output.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _CODEGEN_EMIT_H
+#define _CODEGEN_EMIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "name.h"
+
+#define EMIT_BUFFER_SIZE (256 * 1024)
+
+/*
+ * Output is appended to one growable buffer. With a file descriptor the
+ * buffer is written out whenever it fills up, without one (fd < 0) it
+ * just keeps growing and the caller takes the data.
+ */
+typedef struct {
+        int fd;
+        bool failed;
+        char* data;
+        size_t size;
+        size_t capacity;
+} emitter_t;
+
+bool emit_reserve(emitter_t* emitter, size_t length);
+
+static inline void emit_string(emitter_t* emitter, const char* string, size_t length)
+{
+        if (length > emitter->capacity - emitter->size && !emit_reserve(emitter, length)) {
+                return;
+        }
+
+        memcpy(emitter->data + emitter->size, string, length);
+        emitter->size += length;
+}
+
+static inline void emit_char(emitter_t* emitter, char c)
+{
+        if (emitter->size == emitter->capacity && !emit_reserve(emitter, 1)) {
+                return;
+        }
+
+        emitter->data[emitter->size++] = c;
+}
+
+static inline void emit_name(emitter_t* emitter, name_t* name)
+{
+        emit_string(emitter, name->string, name->length);
+}
+
+/* For string literals, the length is known at compile time */
+#define emit_literal(emitter, string) emit_string(emitter, string, sizeof(string) - 1)
+
+bool emit_join(emitter_t* emitter, emitter_t* parts, size_t n_parts);
+bool emit_flush(emitter_t* emitter);
+void emitter_destroy(emitter_t* emitter);
+bool emitter_init(emitter_t* emitter, int fd, size_t capacity);
+
+#endif /* !_CODEGEN_EMIT_H */
@@ -0,0 +1,79 @@
+/*
+ * Compilation of a set of files.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _COMPILE_H
+#define _COMPILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "cache.h"
+#include "interface.h"
+#include "report.h"
+#include "sha256.h"
+#include "trace.h"
+
+typedef enum {
+        EMIT_ASM,
+        EMIT_TOKENS,
+        EMIT_AST,
+        EMIT_INTERFACE
+} emit_kind_t;
+
+typedef struct {
+        char* input_filename;
+        char* output_filename;
+        bool status;
+} job_t;
+
+typedef bool (*import_loader_t)(interface_t* interface, const char* filename);
+
+/*
+ * Everything one command line asks for. Sessions share nothing but the
+ * read-only interner and the imports load_import hands out, so a server
+ * can run several at once.
+ */
+typedef struct {
+        job_t* jobs;
+        size_t n_jobs;
+        size_t n_threads;
+
+        char* cache_dir;
+        size_t cache_size;
+        bool cache_stats;
+        cache_t cache;
+        uint8_t cache_options[SHA256_SIZE];
+
+        emit_kind_t emit_kind;
+        bool lex_only;
+        bool syntax_only;
+        bool stream_inputs;
+        bool lex_thread;
+
+        char** import_filenames;
+        interface_t* imports;
+        size_t n_imports;
+        import_loader_t load_import; /* Imports it loads are not unloaded */
+
+        bool time_report;
+        bool mem_report;
+        char* report_filename;
+        report_summary_t summary;
+        char* trace_filename;
+        trace_t trace;
+
+        /* Where messages go, NULL for the process's own streams */
+        FILE* out;
+        FILE* err;
+} session_t;
+
+bool session_run(session_t* session);
+void session_destroy(session_t* session);
+/* Parses a command line; out, err and load_import may be set afterwards */
+bool session_init(session_t* session, int argc, char* argv[]);
+
+#endif /* !_COMPILE_H */
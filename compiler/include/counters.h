@@ -0,0 +1,28 @@
+/*
+ * Event counters for compile reports.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _COUNTERS_H
+#define _COUNTERS_H
+
+#include <stdint.h>
+
+/*
+ * Bumped from hot paths, so they are always on and kept
+ * per thread to stay out of each other's cache lines.
+ */
+typedef struct {
+        uint64_t hashmap_lookups;
+        uint64_t hashmap_probes;
+        uint64_t scope_lookups;
+        uint64_t scope_walks; /* Steps to an enclosing scope */
+        uint64_t scope_probes;
+        uint64_t arena_bytes;
+        uint64_t arena_reserved;
+} counters_t;
+
+extern _Thread_local counters_t counters;
+
+#endif /* !_COUNTERS_H */
@@ -0,0 +1,17 @@
+/*
+ * Human-readable dumps of compiler stages.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _DUMP_H
+#define _DUMP_H
+
+#include <stdio.h>
+#include "lexer/token_stream.h"
+#include "parser/ast.h"
+
+void dump_tokens(FILE* file, token_stream_t* tokens);
+void dump_tree(FILE* file, ast_t* ast, ast_node_t* root);
+
+#endif /* !_DUMP_H */
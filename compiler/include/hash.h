@@ -1,5 +1,5 @@
 /*
- * FNV-1a hash function.
+ * Word-at-a-time hash function.
  * Copyright (c) 2023-2024, Quinn Stephens.
  * Provided under the BSD 3-Clause license.
  */
@@ -10,12 +10,55 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#define FNV_PRIME        0x01000193
-#define FNV_OFFSET_BASIS 0x811c9dc5
+#define HASH_SEED 0x9e3779b97f4a7c15ULL
+#define HASH_MUL  0xff51afd7ed558ccdULL
 
-typedef uint32_t hash_t;
+typedef uint64_t hash_t;
 
-hash_t hash_data(void* data, size_t length);
-hash_t hash_string(char *str);
+static inline hash_t hash_mix(hash_t hash, uint64_t word)
+{
+        hash = (hash ^ word) * HASH_MUL;
+        return hash ^ (hash >> 32);
+}
+
+static inline hash_t hash_finish(hash_t hash)
+{
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        return hash ^ (hash >> 29);
+}
+
+/*
+ * Same result as hash_data(), but loads the last partial word whole.
+ * At least 7 readable bytes must follow the data, which the lexer's
+ * source padding guarantees.
+ */
+static inline hash_t hash_padded(const char* data, size_t length)
+{
+        hash_t hash;
+        uint64_t word;
+
+        hash = HASH_SEED ^ (length * HASH_MUL);
+        for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+                __builtin_memcpy(&word, data, sizeof(uint64_t));
+                hash = hash_mix(hash, word);
+                data += sizeof(uint64_t);
+        }
+
+        if (length > 0) {
+                __builtin_memcpy(&word, data, sizeof(uint64_t));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                word &= ~0ULL << (64 - length * 8);
+#else
+                word &= ~0ULL >> (64 - length * 8);
+#endif
+                hash = hash_mix(hash, word);
+        }
+
+        return hash_finish(hash);
+}
+
+hash_t hash_data(const void* data, size_t length);
+hash_t hash_string(const char* str);
 
 #endif /* !_HASH_H */
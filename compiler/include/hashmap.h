@@ -7,17 +7,40 @@
 #ifndef _HASHMAP_H
 #define _HASHMAP_H
 
-#include "list.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "arena.h"
 #include "hash.h"
 
+/* Hash value reserved for empty slots */
+#define HASHMAP_EMPTY 0
+
+/* Grow once more than 3/4 of the slots are used */
+#define HASHMAP_LOAD_NUM 3
+#define HASHMAP_LOAD_DEN 4
+
 typedef struct {
-        list_entry_t list_entry;
         hash_t hash;
-} hashmap_entry_t;
+        uint32_t length;
+        const char *key; /* May not be zero-terminated */
+        void *value;
+} hashmap_slot_t;
+
+/*
+ * Open addressing with linear probing. Hashes are stored inline so
+ * that most mismatches are rejected without touching the key.
+ * Slots come from the arena if one is given, otherwise from malloc().
+ */
+typedef struct {
+        hashmap_slot_t *slots;
+        size_t capacity;
+        size_t count;
+        arena_t *arena;
+} hashmap_t;
 
-void hashmap_remove(hashmap_entry_t *entry);
-void hashmap_add(list_entry_t *rows, hashmap_entry_t *entry, size_t n_rows);
-hashmap_entry_t *hashmap_find(list_entry_t *rows, hash_t hash, size_t n_rows);
-void hashmap_init(list_entry_t *rows, size_t n_rows);
+bool hashmap_add(hashmap_t *map, const char *key, size_t length, hash_t hash, void *value);
+void *hashmap_find(hashmap_t *map, const char *key, size_t length, hash_t hash);
+void hashmap_destroy(hashmap_t *map);
+bool hashmap_init(hashmap_t *map, size_t capacity, arena_t *arena);
 
 #endif /* !_HASHMAP_H */
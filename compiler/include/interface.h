@@ -0,0 +1,85 @@
+/*
+ * Binary interface files.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _INTERFACE_H
+#define _INTERFACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+#include "parser/ast.h"
+#include "sha256.h"
+
+#define INTERFACE_MAGIC   "QKIF"
+#define INTERFACE_VERSION 1
+
+/*
+ * An interface file holds the declarations of one source file, already
+ * resolved: sizes, pointer depths and members are stored, and types are
+ * referred to by name. The layout is
+ *
+ *     header | symbols[n_slots] | members[n_members] | strings
+ *
+ * Symbols form an open-addressing hash table, so a lookup only touches
+ * the slots it probes. Strings are referred to by offset and length.
+ */
+typedef struct {
+        char magic[4];
+        uint32_t version;
+        uint8_t source_hash[SHA256_SIZE];
+        uint32_t word_bytes;
+        uint32_t source_path;
+        uint32_t source_path_length;
+        uint32_t n_slots; /* Power of two */
+        uint32_t n_members;
+        uint32_t strings_size;
+} interface_header_t;
+
+typedef struct {
+        uint64_t hash; /* 0 if the slot is empty */
+        uint32_t name;
+        uint32_t name_length;
+        uint32_t type_name; /* Aliased or returned type */
+        uint32_t type_length; /* 0 if there is none */
+        uint32_t bytes;
+        uint32_t first_member; /* Struct members or parameters */
+        uint32_t n_members;
+        uint16_t ptr_depth;
+        uint8_t kind;
+        uint8_t flags;
+} interface_symbol_t;
+
+typedef struct {
+        uint32_t name;
+        uint32_t name_length;
+        uint32_t type_name;
+        uint32_t type_length;
+        uint32_t bytes;
+        uint16_t ptr_depth;
+        uint16_t reserved;
+} interface_member_t;
+
+typedef struct {
+        void* map;
+        size_t size;
+        const interface_header_t* header;
+        const interface_symbol_t* symbols;
+        const interface_member_t* members;
+        const char* strings;
+} interface_t;
+
+static inline const char* interface_string(const interface_t* interface, uint32_t offset)
+{
+        return interface->strings + offset;
+}
+
+const interface_symbol_t* interface_find(const interface_t* interface, const char* name, size_t length, bool type);
+bool interface_write(ast_t* ast, ast_node_t* types, ast_node_t* procedures, const char* source_path, const char* source, size_t size, int fd);
+void interface_unload(interface_t* interface);
+bool interface_load(interface_t* interface, const char* filename);
+
+#endif /* !_INTERFACE_H */
@@ -0,0 +1,47 @@
+/*
+ * String interning.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _INTERN_H
+#define _INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+#include "hash.h"
+#include "hashmap.h"
+#include "name.h"
+
+typedef struct {
+        char* string;
+        uint32_t length;
+} interned_t;
+
+typedef struct {
+        arena_t arena;
+        hashmap_t table;
+        interned_t* strings;
+        size_t count;
+        size_t capacity;
+        symbol_t first; /* Symbol of strings[0] */
+} interner_t;
+
+/*
+ * There is one shared interner holding keywords and builtin names,
+ * filled by intern_init() and whatever runs before the first
+ * interner_init(). After that it is read-only. Each thread compiling
+ * a file binds its own interner, which numbers new strings after the
+ * shared ones, so threads never write to common state.
+ */
+symbol_t intern(const char* string, size_t length, hash_t hash);
+void symbol_name(symbol_t symbol, name_t* name);
+void interner_destroy(interner_t* interner);
+/* Binds interner to the calling thread, returning the one it replaces */
+interner_t* interner_bind(interner_t* interner);
+bool interner_init(interner_t* interner);
+void intern_destroy(void);
+bool intern_init(void);
+
+#endif /* !_INTERN_H */
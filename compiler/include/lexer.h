@@ -10,10 +10,12 @@
 #include <stdbool.h>
 #include "lexer/token.h"
 
+/* Zeroed bytes required after the end of the source */
+#define LEXER_PADDING 64
+
+/* Locations are worked out from token offsets when they are needed */
 typedef struct {
         char* pos;
-        char* line_start;
-        int line;
 } lexer_t;
 
 void lexer_next(lexer_t* lexer, token_t* token);
@@ -7,17 +7,23 @@
 #ifndef _LEXER_KEYWORD_H
 #define _LEXER_KEYWORD_H
 
-#include "hashmap.h"
 #include "lexer/token.h"
 #include "name.h"
 
-typedef struct {
-        hashmap_entry_t hashmap_entry;
-        name_t name;
-        token_kind_t value;
-} keyword_t;
+/* Keywords are interned before anything else, in this order */
+enum {
+#define KEYWORD(string, kind) KEYWORD_##kind,
+#include "lexer/keywords.def"
+#undef KEYWORD
+        KEYWORD_COUNT
+};
 
-keyword_t* keywords_find(token_t* token);
-void keywords_init();
+extern const token_kind_t keyword_kinds[KEYWORD_COUNT + 1];
+
+/* Token kind for an identifier's symbol */
+static inline token_kind_t keyword_kind(symbol_t symbol)
+{
+        return symbol <= KEYWORD_COUNT ? keyword_kinds[symbol] : TK_IDENTIFIER;
+}
 
 #endif /* !_LEXER_KEYWORD_H */
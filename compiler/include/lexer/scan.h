@@ -0,0 +1,24 @@
+/*
+ * Vectorized character scanning.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _LEXER_SCAN_H
+#define _LEXER_SCAN_H
+
+/*
+ * Scanners may read up to LEXER_PADDING bytes past the terminating NUL,
+ * so sources must be allocated with that much zeroed padding.
+ */
+typedef struct {
+        char* (*whitespace)(char* pos);
+        char* (*identifier)(char* pos);
+        char* (*quoted)(char* pos, char quote);
+} scanner_t;
+
+extern scanner_t scanner;
+
+void scanner_init(void);
+
+#endif /* !_LEXER_SCAN_H */
@@ -9,7 +9,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
-#include "hash.h"
+#include "name.h"
 
 typedef enum {
         TK_UNKNOWN,
@@ -59,6 +59,8 @@ typedef enum {
         TK_IF
 } token_kind_t;
 
+#define TK_COUNT (TK_IF + 1)
+
 #define TF_NONE 0
 #define TF_ASSIGNMENT (1 << 0)
 
@@ -67,12 +69,10 @@ typedef struct {
         uint8_t flags;
 
         char* pos;
-        int line;
-        int column;
         size_t length;
 
         union {
-                hash_t hash;
+                symbol_t symbol;
                 uint64_t value;
         };
 } token_t;
@@ -0,0 +1,65 @@
+/*
+ * Lexing on a thread of its own.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _LEXER_TOKEN_PIPE_H
+#define _LEXER_TOKEN_PIPE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+
+/* Tokens the lexer can get ahead of the parser, a power of two */
+#define TOKEN_PIPE_SIZE  8192
+
+/* Tokens the lexer writes before letting the parser see any of them */
+#define TOKEN_PIPE_BATCH 256
+
+typedef struct {
+        uint64_t value; /* Symbols are the lexer thread's own */
+        uint32_t offset;
+        uint32_t length;
+        uint8_t kind;
+        uint8_t flags;
+} piped_token_t;
+
+/*
+ * Single-producer, single-consumer ring. Each side only writes its own
+ * index, on a cache line of its own, and only sleeps once it has caught
+ * up with the other side.
+ */
+typedef struct {
+        /* Written by the lexer */
+        _Alignas(64) atomic_uint tail;
+        atomic_bool lexer_waiting;
+        bool failed;
+
+        /* Written by the parser */
+        _Alignas(64) atomic_uint head;
+        atomic_bool parser_waiting;
+        uint32_t tail_seen;
+        symbol_t* symbols; /* The file's symbol for each of the lexer's */
+        size_t max_symbols;
+
+        _Alignas(64) char* source;
+        interner_t interner;
+        pthread_t thread;
+        piped_token_t tokens[TOKEN_PIPE_SIZE];
+} token_pipe_t;
+
+/* Waits for tokens, returning how many can be read in a row from *tokens */
+size_t token_pipe_read(token_pipe_t* pipe, piped_token_t** tokens);
+/* Hands the n tokens that were read back to the lexer */
+void token_pipe_release(token_pipe_t* pipe, size_t n);
+/* The file's symbol for a name the lexer thread interned, or SYMBOL_NONE */
+symbol_t token_pipe_symbol(token_pipe_t* pipe, piped_token_t* token);
+/* Only once TK_EOF has been read, since until then the lexer may be waiting for room */
+void token_pipe_destroy(token_pipe_t* pipe);
+token_pipe_t* token_pipe_create(char* source);
+
+#endif /* !_LEXER_TOKEN_PIPE_H */
@@ -0,0 +1,134 @@
+/*
+ * Pre-lexed token storage.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _LEXER_TOKEN_STREAM_H
+#define _LEXER_TOKEN_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lexer/token.h"
+#include "lexer/token_pipe.h"
+#include "intern.h"
+
+/* Input read from a pipe is lexed this much at a time */
+#define STREAM_WINDOW_SIZE (256 * 1024)
+
+/* Sources in memory that are lexed as they are needed get this many tokens at a time */
+#define LEX_BATCH_SIZE 4096
+
+/* Sources are split between threads into chunks of at least this much */
+#define LEX_CHUNK_MIN_SIZE (1024 * 1024)
+
+/* Tokens are referred to by their index in the stream */
+typedef uint32_t token_id_t;
+
+/* Gets each part of a streamed source as its tokens are lexed, before it is dropped */
+typedef void (*window_handler_t)(void* context, const char* data, size_t size);
+
+/* Input read from a pipe, lexed a window at a time as tokens are needed */
+typedef struct {
+        int fd;
+        char* data;
+        size_t size;
+        size_t capacity;
+        uint64_t base;          /* Offset of data in the whole input */
+        token_id_t next_line;   /* First token not known to start before data */
+        bool eof;
+
+        window_handler_t on_window;
+        void* context;
+} token_window_t;
+
+/*
+ * Structure-of-arrays token storage. The parser mostly looks at kinds,
+ * so keeping them in their own array keeps lookahead cheap. Tokens that
+ * are pulled in as they are needed can be dropped once they are done
+ * with, so the arrays only hold those from first on.
+ */
+typedef struct {
+        uint8_t* kinds;
+        uint8_t* flags;
+        uint32_t* offsets; /* From the start of the source, which is under 4 GiB in memory */
+        uint32_t* lengths;
+        uint64_t* values;  /* Symbol for identifiers, value for numbers */
+
+        token_id_t first;  /* Held at index 0 */
+        token_id_t keep;   /* Tokens before this one may be dropped */
+        size_t count;      /* Tokens lexed so far, dropped ones included */
+        size_t capacity;
+
+        /*
+         * Where each line of a streamed source starts, and the first token
+         * at or after it. Built while reading since the source is gone by
+         * then, and dropped along with the tokens.
+         */
+        uint32_t* line_offsets;
+        token_id_t* line_tokens;
+        size_t n_lines;
+        size_t max_lines;
+        size_t first_line;
+
+        /* Sources in memory are only scanned for lines up to the last location asked for */
+        uint32_t scanned;
+        uint32_t scanned_line_start;
+        size_t scanned_lines;
+
+        char* source; /* NULL for a streamed source */
+        char* next;   /* Where lexing the source goes on, if it is lexed as needed */
+        const char* filename;
+
+        /* Set while more tokens come from tokens_pull() */
+        bool pending;
+        token_pipe_t* pipe;
+        token_window_t* window;
+        bool failed;
+} token_stream_t;
+
+void token_location(token_stream_t* tokens, token_id_t id, int* line, int* column);
+void tokens_pull(token_stream_t* tokens);
+bool tokens_finish(token_stream_t* tokens);
+bool tokens_lex_piped(token_stream_t* tokens, const char* filename, char* source);
+bool tokens_lex_lazy(token_stream_t* tokens, const char* filename, char* source);
+/* Sources in memory are lexed on up to n_threads threads */
+bool tokens_lex(token_stream_t* tokens, const char* filename, char* source, size_t size, size_t n_threads);
+/* Takes fd, which is closed once the input ends */
+bool tokens_lex_stream(token_stream_t* tokens, const char* filename, int fd, window_handler_t on_window, void* context);
+void tokens_destroy(token_stream_t* tokens);
+
+/* Where a token that has not been dropped is held */
+static inline size_t token_index(token_stream_t* tokens, token_id_t id)
+{
+        return id - tokens->first;
+}
+
+static inline char* token_pos(token_stream_t* tokens, token_id_t id)
+{
+        return tokens->source + tokens->offsets[token_index(tokens, id)];
+}
+
+static inline void token_name(token_stream_t* tokens, token_id_t id, name_t* name)
+{
+        symbol_name((symbol_t)tokens->values[token_index(tokens, id)], name);
+}
+
+/* Whether there is a token id, pulling tokens in until there is */
+static inline bool tokens_have(token_stream_t* tokens, token_id_t id)
+{
+        while (id >= tokens->count && tokens->pending) {
+                tokens_pull(tokens);
+        }
+
+        return id < tokens->count;
+}
+
+/* Nothing before token id is looked at again */
+static inline void tokens_drop(token_stream_t* tokens, token_id_t id)
+{
+        tokens->keep = id;
+}
+
+#endif /* !_LEXER_TOKEN_STREAM_H */
@@ -7,7 +7,8 @@
 #ifndef _LOG_H
 #define _LOG_H
 
-#include "lexer/token.h"
+#include <stdio.h>
+#include "lexer/token_stream.h"
 
 #ifdef ENABLE_DEBUG
 void __debug(const char* func, const char* msg);
@@ -17,7 +18,13 @@ void __debug(const char* func, const char* msg);
 #define debug(msg)
 #endif
 
-void error(token_t* token, const char* fmt, ...);
-void warn(token_t* token, const char* fmt, ...);
+/* Output goes to the process's own streams unless a thread redirects it */
+void log_redirect(FILE* out, FILE* err);
+FILE* log_stdout(void);
+FILE* log_stderr(void);
+void log_errno(const char* prefix);
+
+void error(token_stream_t* tokens, token_id_t token, const char* fmt, ...);
+void warn(token_stream_t* tokens, token_id_t token, const char* fmt, ...);
 
 #endif /* !_LOG_H */
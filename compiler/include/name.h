@@ -1,5 +1,5 @@
 /*
- * Hashed name structure.
+ * Interned name structure.
  * Copyright (c) 2023-2024, Quinn Stephens.
  * Provided under the BSD 3-Clause license.
  */
@@ -7,13 +7,17 @@
 #ifndef _NAME_H
 #define _NAME_H
 
-#include <stddef.h>
-#include "hash.h"
+#include <stdint.h>
+
+/* Dense id of an interned string, equal ids mean equal strings */
+typedef uint32_t symbol_t;
+
+#define SYMBOL_NONE 0
 
 typedef struct {
-        char* string; /* May not be zero-terminated */
-        size_t length;
-        hash_t hash;
+        char* string; /* Interned copy, zero-terminated */
+        uint32_t length;
+        symbol_t symbol;
 } name_t;
 
 #endif /* !_NAME_H */
@@ -7,24 +7,74 @@
 #ifndef _PARSER_H
 #define _PARSER_H
 
-#include "lexer.h"
+#include "arena.h"
+#include "interface.h"
+#include "lexer/token_stream.h"
 #include "parser/ast.h"
+#include "parser/scope.h"
+
+/* Gets a procedure definition whose body, from node body on, is about to be released */
+typedef void (*definition_handler_t)(void* context, ast_t* ast, ast_node_t* procedure, node_id_t body);
 
 typedef struct {
-        lexer_t lexer;
-        token_t token;
+        arena_t arena;
+        ast_t ast;
+        token_stream_t tokens;
+        token_id_t cursor;
         ast_node_t* types;
         ast_node_t* procedures;
+
+        /* Symbol tables, local ones are only kept while their procedure is parsed */
+        arena_t local_arena;
+        scope_t* type_scope;
+        scope_t* proc_scope;
+        scope_t* scope;
+
+        /* Interfaces searched for names the source does not declare */
+        const interface_t* imports;
+        size_t n_imports;
+
+        /* Set to handle definitions as they are parsed instead of keeping them */
+        definition_handler_t on_definition;
+        void* definition_context;
 } parser_t;
 
-static inline token_t* next_token(parser_t* parser)
+/* Kind of the current token */
+static inline token_kind_t token_kind(parser_t* parser)
 {
-        lexer_next(&parser->lexer, &parser->token);
-        return &parser->token;
+        return parser->tokens.kinds[token_index(&parser->tokens, parser->cursor)];
 }
 
+/* Kind of the token n places ahead, the stream always ends with TK_EOF */
+static inline token_kind_t peek_token(parser_t* parser, size_t n)
+{
+        if (!tokens_have(&parser->tokens, parser->cursor + n)) {
+                return TK_EOF;
+        }
+
+        return parser->tokens.kinds[token_index(&parser->tokens, parser->cursor + n)];
+}
+
+/* Advances to the next token and returns its kind, stops at TK_EOF */
+static inline token_kind_t next_token(parser_t* parser)
+{
+        /* Tokens that are lexed as they are needed get pulled in here */
+        if (tokens_have(&parser->tokens, parser->cursor + 1)) {
+                parser->cursor++;
+        }
+
+        return token_kind(parser);
+}
+
+/* Error at the current token */
+#define parser_error(parser, ...) error(&(parser)->tokens, (parser)->cursor, __VA_ARGS__)
+#define parser_warn(parser, ...)  warn(&(parser)->tokens, (parser)->cursor, __VA_ARGS__)
+
 void parser_destory(parser_t* parser);
-void parser_parse(parser_t* parser);
-void parser_init(parser_t* parser, char* source);
+bool parser_parse(parser_t* parser);
+bool parser_init_piped(parser_t* parser, const char* filename, char* source);
+bool parser_init_lazy(parser_t* parser, const char* filename, char* source);
+bool parser_init_stream(parser_t* parser, const char* filename, int fd, window_handler_t on_window, void* context);
+bool parser_init(parser_t* parser, const char* filename, char* source, size_t size, size_t n_threads);
 
 #endif /* !_PARSER_H */
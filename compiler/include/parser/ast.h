@@ -8,6 +8,7 @@
 #define _PARSER_AST_H
 
 #include <stdint.h>
+#include "arena.h"
 #include "lexer/token.h"
 #include "name.h"
 
@@ -31,64 +32,86 @@ typedef enum {
         NK_NUMBER
 } node_kind_t;
 
+#define NK_COUNT (NK_NUMBER + 1)
+
+extern const char* node_kind_strings[NK_COUNT];
+
 #define NF_NONE       0
 #define NF_NAMED      (1 << 0)
 #define NF_PUBLIC     (1 << 1)
-#define NF_VISITED    (1 << 2)
-#define NF_DEFINITION (1 << 3)
+#define NF_DEFINITION (1 << 2)
+#define NF_IMPORTED   (1 << 3)
+
+/* Nodes are referred to by their index in the AST pool */
+typedef uint32_t node_id_t;
+
+#define NODE_NONE 0
 
-struct ast_node;
+#define AST_CHUNK_SHIFT 12
+#define AST_CHUNK_NODES (1 << AST_CHUNK_SHIFT)
 
 typedef struct {
-        struct ast_node* head;
-        struct ast_node* tail;
+        node_id_t head;
+        node_id_t tail;
 } ast_node_list_t;
 
-typedef struct ast_node {
-        node_kind_t kind;
+typedef struct {
+        uint8_t kind;
         uint8_t flags;
-        name_t name;
 
-        /* Builtin type, struct, variable */
-        size_t bytes;
+        /* Procedure, parameter, variable, member, alias */
+        uint16_t ptr_depth;
 
-        /* Procedure */
-        int n_params;
-        ast_node_list_t params;
-        size_t local_size;
+        /* Builtin type, struct, variable */
+        uint32_t bytes;
 
-        /* Procedure, parameter, local variable */
-        struct ast_node* type;
-        size_t ptr_depth;
+        node_id_t id;
+        node_id_t parent;
+        node_id_t next;
+        ast_node_list_t children;
 
-        /* String */
-        int id;
-        size_t length;
-        char* data;
+        /* Procedure, parameter, variable, member, alias, return */
+        node_id_t type;
 
-        /* Enumeration */
-        size_t n_values;
-        uint64_t* values;
+        name_t name;
 
         /* Fields only used by one kind of node */
         union {
-                size_t local_offset;          /* Local variable */
-                struct ast_node* destination; /* Assignment */
-                struct ast_node* callee;      /* Call */
-                uint64_t value;               /* Number */
-                struct ast_node* variable;    /* Variable reference */
-                struct ast_node* string;      /* String reference */
+                uint32_t local_size;   /* Procedure */
+                uint32_t local_offset; /* Local variable */
+                node_id_t callee;      /* Call */
+                node_id_t variable;    /* Variable reference */
+                uint64_t value;        /* Number */
         };
-
-        struct ast_node* parent;
-        ast_node_list_t children;
-        struct ast_node* prev;
-        struct ast_node* next;
 } ast_node_t;
 
-ast_node_t* create_node(ast_node_t* parent);
-void push_node(ast_node_t* node, ast_node_list_t* list);
-void delete_nodes(ast_node_t* top_node);
-ast_node_t* find_node(token_t* name, ast_node_t* parent);
+/*
+ * Nodes are stored in fixed-size chunks so that pointers stay valid
+ * while the pool grows. Since the parser works depth-first, every
+ * declaration ends up as one contiguous preorder run of nodes.
+ */
+typedef struct {
+        arena_t* arena;
+        ast_node_t** chunks;
+        size_t n_chunks;
+        size_t max_chunks;
+        node_id_t n_nodes;
+        node_id_t pinned; /* Nodes up to this one survive delete_nodes() */
+} ast_t;
+
+static inline ast_node_t* get_node(ast_t* ast, node_id_t id)
+{
+        return &ast->chunks[id >> AST_CHUNK_SHIFT][id & (AST_CHUNK_NODES - 1)];
+}
+
+ast_node_t* create_node(ast_t* ast, ast_node_t* parent);
+void push_node(ast_t* ast, ast_node_t* node, ast_node_list_t* list);
+/* First node from id on that deleting or releasing would free */
+node_id_t first_deletable(ast_t* ast, node_id_t id);
+void delete_nodes(ast_t* ast, ast_node_t* top_node);
+/* Frees the finished subtree of parent from first on, keeping earlier children */
+void release_nodes(ast_t* ast, ast_node_t* parent, node_id_t first);
+void ast_destroy(ast_t* ast);
+void ast_init(ast_t* ast, arena_t* arena);
 
 #endif /* !_PARSER_AST_H */
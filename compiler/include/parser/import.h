@@ -0,0 +1,16 @@
+/*
+ * Resolves names from imported interfaces.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _PARSER_IMPORT_H
+#define _PARSER_IMPORT_H
+
+#include "name.h"
+#include "parser.h"
+
+ast_node_t* import_type(parser_t* parser, name_t* name);
+ast_node_t* import_procedure(parser_t* parser, name_t* name);
+
+#endif /* !_PARSER_IMPORT_H */
@@ -0,0 +1,40 @@
+/*
+ * Scoped symbol tables.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _PARSER_SCOPE_H
+#define _PARSER_SCOPE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "name.h"
+#include "parser/ast.h"
+
+/* Initial table sizes, tables grow as needed */
+#define GLOBAL_SCOPE_SIZE 256
+#define LOCAL_SCOPE_SIZE  16
+
+typedef struct {
+        symbol_t symbol; /* SYMBOL_NONE if empty */
+        ast_node_t* node;
+} scope_slot_t;
+
+/*
+ * Open addressing keyed on interned symbols, so a probe is a single
+ * integer compare. Slots come from the arena the scope was created in.
+ */
+typedef struct scope {
+        struct scope* parent;
+        arena_t* arena;
+        scope_slot_t* slots;
+        uint32_t capacity;
+        uint32_t count;
+} scope_t;
+
+ast_node_t* scope_find(scope_t* scope, name_t* name);
+bool scope_add(scope_t* scope, ast_node_t* node);
+scope_t* create_scope(arena_t* arena, scope_t* parent, size_t size);
+
+#endif /* !_PARSER_SCOPE_H */
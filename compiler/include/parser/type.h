@@ -7,11 +7,12 @@
 #ifndef _PARSER_TYPE_H
 #define _PARSER_TYPE_H
 
-#include "lexer/token.h"
+#include <stdbool.h>
 #include "parser.h"
 
-ast_node_t* parse_type_reference(parser_t* parser, ast_node_t* node, token_t* type_name);
+ast_node_t* parse_type_reference(parser_t* parser, ast_node_t* node);
 ast_node_t* parse_type_declaration(parser_t* parser);
-ast_node_t* init_types(void);
+ast_node_t* init_types(ast_t* ast, scope_t* scope);
+bool types_init(void);
 
 #endif /* !_PARSER_TYPE_H */
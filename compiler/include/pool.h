@@ -0,0 +1,22 @@
+/*
+ * Simple worker pool.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*pool_job_t)(void* context, size_t index);
+
+/*
+ * Calls job(context, i) for every i below count, spread over up to
+ * n_threads threads. Workers take the next index as they finish, and
+ * the calling thread works too. Returns once every job has run.
+ */
+bool pool_run(size_t n_threads, size_t count, pool_job_t job, void* context);
+
+#endif /* !_POOL_H */
@@ -0,0 +1,64 @@
+/*
+ * Per-phase timing and memory reports.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "counters.h"
+#include "lexer/token_stream.h"
+#include "parser/ast.h"
+
+typedef enum {
+        PHASE_LOAD,
+        PHASE_LEX,
+        PHASE_PARSE,
+        PHASE_CODEGEN,
+        PHASE_OUTPUT,
+        PHASE_COUNT
+} phase_t;
+
+typedef struct {
+        uint64_t wall;
+        uint64_t cpu;
+} report_clock_t;
+
+typedef struct {
+        /* Nanoseconds, summed over files */
+        uint64_t wall[PHASE_COUNT];
+        uint64_t cpu[PHASE_COUNT]; /* Thread time of the compiling thread */
+
+        uint64_t files;
+        uint64_t source_bytes;
+        uint64_t lines;
+        uint64_t tokens;
+        uint64_t token_bytes;
+        uint64_t nodes[NK_COUNT];
+        counters_t counters;
+} report_t;
+
+/* Totals for one run, which may compile several files at once */
+typedef struct {
+        pthread_mutex_t lock;
+        report_t total;
+        report_clock_t start; /* CPU time is for the whole process */
+} report_summary_t;
+
+void report_start(report_clock_t* clock);
+void report_phase(report_t* report, phase_t phase, report_clock_t* clock);
+void report_count_source(report_t* report, const char* source, size_t size);
+void report_count_tokens(report_t* report, token_stream_t* tokens);
+void report_count_nodes(report_t* report, ast_t* ast, node_id_t first);
+void report_begin(report_t* report);
+void report_end(report_summary_t* summary, report_t* report);
+void report_print(report_summary_t* summary, bool time, bool memory);
+bool report_write_json(report_summary_t* summary, const char* filename);
+void report_destroy(report_summary_t* summary);
+void report_init(report_summary_t* summary);
+
+#endif /* !_REPORT_H */
@@ -0,0 +1,26 @@
+/*
+ * Compile server and its client.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <stdbool.h>
+
+/*
+ * A client sends its working directory and arguments, and the server
+ * runs them as a session of its own, sending back everything the
+ * session prints followed by its exit status. The interner, keyword
+ * and type tables, loaded interfaces and spare arena chunks stay warm
+ * between requests.
+ */
+
+/* Serves requests on a Unix socket until SIGINT or SIGTERM */
+bool server_run(const char* path);
+
+/* Returns false if no server is listening on path */
+bool client_run(const char* path, int argc, char* argv[], int* exit_status);
+
+#endif /* !_SERVER_H */
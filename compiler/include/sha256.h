@@ -0,0 +1,26 @@
+/*
+ * SHA-256 message digest.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32
+
+typedef struct {
+        uint32_t state[8];
+        uint64_t length;
+        uint8_t block[64];
+        size_t used;
+} sha256_t;
+
+void sha256_update(sha256_t* ctx, const void* data, size_t length);
+void sha256_final(sha256_t* ctx, uint8_t digest[SHA256_SIZE]);
+void sha256_init(sha256_t* ctx);
+
+#endif /* !_SHA256_H */
@@ -0,0 +1,23 @@
+/*
+ * Source file loading.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _SOURCE_H
+#define _SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+        char* data;      /* Followed by LEXER_PADDING zeroed bytes */
+        size_t size;
+        size_t map_size; /* 0 if data was read into the heap */
+} source_t;
+
+bool source_load(source_t* source, const char* filename);
+int source_open_stream(const char* filename, bool force);
+void source_unload(source_t* source);
+
+#endif /* !_SOURCE_H */
@@ -0,0 +1,52 @@
+/*
+ * Chrome trace timelines.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+typedef struct {
+        uint64_t start; /* Nanoseconds */
+        uint64_t duration;
+        uint32_t thread;
+        const char* category;
+        char* name;
+} trace_event_t;
+
+/* Spans recorded by every thread working for one run */
+typedef struct {
+        pthread_mutex_t lock;
+        trace_event_t* events;
+        size_t count;
+        size_t capacity;
+        arena_t names;
+        uint64_t origin;
+} trace_t;
+
+typedef struct {
+        uint64_t start; /* 0 if nothing is being traced */
+} trace_span_t;
+
+/*
+ * Spans go to the trace bound to the current thread, so threads that
+ * are not tracing only pay for checking it.
+ */
+void trace_bind(trace_t* trace);
+trace_t* trace_current(void);
+
+void trace_add(const char* category, const char* name, size_t length, uint64_t start, uint64_t end);
+void trace_begin(trace_span_t* span);
+void trace_end(trace_span_t* span, const char* category, const char* name, size_t length);
+bool trace_write(trace_t* trace, const char* filename);
+void trace_destroy(trace_t* trace);
+void trace_init(trace_t* trace);
+
+#endif /* !_TRACE_H */
@@ -0,0 +1,13 @@
+/*
+ * Compiler version.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#ifndef _VERSION_H
+#define _VERSION_H
+
+/* Bump whenever generated code changes, cached outputs depend on it */
+#define QUARK_VERSION "0.1.0"
+
+#endif /* !_VERSION_H */
@@ -0,0 +1,436 @@
+/*
+ * Binary interface files.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "codegen/emit.h"
+#include "interface.h"
+#include "log.h"
+#include "source.h"
+
+typedef struct {
+        interface_symbol_t* symbols;
+        uint32_t n_slots;
+
+        interface_member_t* members;
+        uint32_t n_members;
+        uint32_t max_members;
+
+        char* strings;
+        uint32_t strings_size;
+        uint32_t max_strings;
+} writer_t;
+
+static inline uint64_t symbol_hash(const char* name, size_t length)
+{
+        hash_t hash;
+
+        /* 0 marks an empty slot */
+        hash = hash_data(name, length);
+        return hash != 0 ? hash : 1;
+}
+
+static inline bool is_type_kind(uint8_t kind)
+{
+        return kind != NK_PROCEDURE;
+}
+
+static bool add_string(writer_t* writer, const char* string, uint32_t length, uint32_t* offset)
+{
+        if (writer->strings_size + length > writer->max_strings) {
+                uint32_t max_strings;
+                char* strings;
+
+                max_strings = writer->max_strings != 0 ? writer->max_strings : 4096;
+                while (writer->strings_size + length > max_strings) {
+                        max_strings *= 2;
+                }
+
+                strings = realloc(writer->strings, max_strings);
+                if (strings == NULL) {
+                        return false;
+                }
+
+                writer->strings = strings;
+                writer->max_strings = max_strings;
+        }
+
+        memcpy(writer->strings + writer->strings_size, string, length);
+        *offset = writer->strings_size;
+        writer->strings_size += length;
+        return true;
+}
+
+static bool add_type_name(writer_t* writer, ast_t* ast, node_id_t type, uint32_t* offset, uint32_t* length)
+{
+        ast_node_t* node;
+
+        if (type == NODE_NONE) {
+                *offset = 0;
+                *length = 0;
+                return true;
+        }
+
+        node = get_node(ast, type);
+        *length = node->name.length;
+        return add_string(writer, node->name.string, node->name.length, offset);
+}
+
+static bool add_members(writer_t* writer, ast_t* ast, ast_node_t* parent, uint8_t member_kind, interface_symbol_t* symbol)
+{
+        interface_member_t* member;
+        ast_node_t* node;
+
+        symbol->first_member = writer->n_members;
+        symbol->n_members = 0;
+        for (node_id_t id = parent->children.head; id != NODE_NONE; id = node->next) {
+                node = get_node(ast, id);
+                if (node->kind != member_kind) {
+                        continue;
+                }
+
+                if (writer->n_members == writer->max_members) {
+                        interface_member_t* members;
+                        uint32_t max_members;
+
+                        max_members = writer->max_members != 0 ? writer->max_members * 2 : 64;
+                        members = realloc(writer->members, max_members * sizeof(interface_member_t));
+                        if (members == NULL) {
+                                return false;
+                        }
+
+                        writer->members = members;
+                        writer->max_members = max_members;
+                }
+
+                member = &writer->members[writer->n_members++];
+                memset(member, 0, sizeof(interface_member_t));
+                member->name_length = node->name.length;
+                member->bytes = node->bytes;
+                member->ptr_depth = node->ptr_depth;
+                if (!add_string(writer, node->name.string, node->name.length, &member->name)
+                        || !add_type_name(writer, ast, node->type, &member->type_name, &member->type_length)) {
+                        return false;
+                }
+
+                symbol->n_members++;
+        }
+
+        return true;
+}
+
+static bool add_symbol(writer_t* writer, ast_t* ast, ast_node_t* node)
+{
+        interface_symbol_t* symbol;
+        uint32_t mask, i;
+        uint64_t hash;
+
+        hash = symbol_hash(node->name.string, node->name.length);
+        mask = writer->n_slots - 1;
+        for (i = hash & mask; writer->symbols[i].hash != 0; i = (i + 1) & mask) {
+                symbol = &writer->symbols[i];
+
+                /* Forward declarations and their definitions share a prototype */
+                if (symbol->hash == hash && symbol->name_length == node->name.length
+                        && is_type_kind(symbol->kind) == is_type_kind(node->kind)
+                        && memcmp(writer->strings + symbol->name, node->name.string, node->name.length) == 0) {
+                        return true;
+                }
+        }
+
+        symbol = &writer->symbols[i];
+        symbol->hash = hash;
+        symbol->name_length = node->name.length;
+        symbol->bytes = node->bytes;
+        symbol->ptr_depth = node->ptr_depth;
+        symbol->kind = node->kind;
+        symbol->flags = node->flags & NF_PUBLIC;
+        if (!add_string(writer, node->name.string, node->name.length, &symbol->name)
+                || !add_type_name(writer, ast, node->type, &symbol->type_name, &symbol->type_length)) {
+                return false;
+        }
+
+        if (node->kind == NK_STRUCT) {
+                return add_members(writer, ast, node, NK_STRUCT_MEMBER, symbol);
+        } else if (node->kind == NK_PROCEDURE) {
+                return add_members(writer, ast, node, NK_PARAMETER, symbol);
+        }
+
+        return true;
+}
+
+static bool is_exported(ast_node_t* node)
+{
+        if (node->flags & NF_IMPORTED) {
+                return false;
+        }
+
+        return node->kind == NK_STRUCT || node->kind == NK_TYPE_ALIAS || node->kind == NK_PROCEDURE;
+}
+
+bool interface_write(ast_t* ast, ast_node_t* types, ast_node_t* procedures, const char* source_path, const char* source, size_t size, int fd)
+{
+        interface_header_t header;
+        ast_node_t* roots[2];
+        emitter_t output;
+        writer_t writer;
+        ast_node_t* node;
+        sha256_t ctx;
+        size_t count;
+        bool status;
+
+        debug("Writing interface...");
+
+        roots[0] = types;
+        roots[1] = procedures;
+
+        /* Keep the table at most half full */
+        count = 0;
+        for (int r = 0; r < 2; r++) {
+                for (node_id_t id = roots[r]->children.head; id != NODE_NONE; id = node->next) {
+                        node = get_node(ast, id);
+                        count += is_exported(node);
+                }
+        }
+
+        memset(&writer, 0, sizeof(writer_t));
+        for (writer.n_slots = 8; writer.n_slots < count * 2; writer.n_slots <<= 1);
+        writer.symbols = calloc(writer.n_slots, sizeof(interface_symbol_t));
+        if (writer.symbols == NULL) {
+                return false;
+        }
+
+        memset(&header, 0, sizeof(interface_header_t));
+        memcpy(header.magic, INTERFACE_MAGIC, sizeof(header.magic));
+        header.version = INTERFACE_VERSION;
+        header.word_bytes = sizeof(void*);
+        header.source_path_length = (uint32_t)strlen(source_path);
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, source, size);
+        sha256_final(&ctx, header.source_hash);
+
+        status = add_string(&writer, source_path, header.source_path_length, &header.source_path);
+        for (int r = 0; r < 2 && status; r++) {
+                for (node_id_t id = roots[r]->children.head; id != NODE_NONE && status; id = node->next) {
+                        node = get_node(ast, id);
+                        if (is_exported(node)) {
+                                status = add_symbol(&writer, ast, node);
+                        }
+                }
+        }
+
+        header.n_slots = writer.n_slots;
+        header.n_members = writer.n_members;
+        header.strings_size = writer.strings_size;
+
+        if (status && emitter_init(&output, fd, EMIT_BUFFER_SIZE)) {
+                emit_string(&output, (char*)&header, sizeof(interface_header_t));
+                emit_string(&output, (char*)writer.symbols, writer.n_slots * sizeof(interface_symbol_t));
+                emit_string(&output, (char*)writer.members, writer.n_members * sizeof(interface_member_t));
+                emit_string(&output, writer.strings, writer.strings_size);
+                status = emit_flush(&output);
+                emitter_destroy(&output);
+        } else {
+                status = false;
+        }
+
+        free(writer.symbols);
+        free(writer.members);
+        free(writer.strings);
+        return status;
+}
+
+const interface_symbol_t* interface_find(const interface_t* interface, const char* name, size_t length, bool type)
+{
+        const interface_symbol_t* symbol;
+        uint32_t mask, i;
+        uint64_t hash;
+
+        /* Loading made sure some slot is empty, but the probe is bounded anyway */
+        hash = symbol_hash(name, length);
+        mask = interface->header->n_slots - 1;
+        i = hash & mask;
+        for (uint32_t n = 0; n < interface->header->n_slots && (symbol = &interface->symbols[i])->hash != 0; n++, i = (i + 1) & mask) {
+                if (symbol->hash != hash || symbol->name_length != length || is_type_kind(symbol->kind) != type) {
+                        continue;
+                }
+
+                if (memcmp(interface_string(interface, symbol->name), name, length) == 0) {
+                        return symbol;
+                }
+        }
+
+        return NULL;
+}
+
+static bool check_source(interface_t* interface, const char* filename)
+{
+        uint8_t digest[SHA256_SIZE];
+        char path[4096];
+        source_t source;
+        sha256_t ctx;
+        uint32_t length;
+
+        length = interface->header->source_path_length;
+        if (length >= sizeof(path)) {
+                return false;
+        }
+
+        memcpy(path, interface_string(interface, interface->header->source_path), length);
+        path[length] = '\0';
+
+        /* Without the source there is nothing to compare against */
+        if (!source_load(&source, path)) {
+                fprintf(log_stderr(), "%s: \033[93mwarning\033[0m: %s cannot be read, so it is not checked\n", filename, path);
+                return true;
+        }
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, source.data, source.size);
+        sha256_final(&ctx, digest);
+        source_unload(&source);
+
+        if (memcmp(digest, interface->header->source_hash, SHA256_SIZE) != 0) {
+                fprintf(log_stderr(), "%s: out of date, %s has changed\n", filename, path);
+                return false;
+        }
+
+        return true;
+}
+
+void interface_unload(interface_t* interface)
+{
+        if (interface->map != NULL) {
+                munmap(interface->map, interface->size);
+        }
+
+        interface->map = NULL;
+        interface->size = 0;
+}
+
+static bool in_strings(const interface_header_t* header, uint32_t offset, uint32_t length)
+{
+        return (uint64_t)offset + length <= header->strings_size;
+}
+
+/* Everything imports rely on, so nothing read from the file is trusted later */
+static bool check_records(interface_t* interface)
+{
+        const interface_header_t* header;
+        const interface_symbol_t* symbol;
+        const interface_member_t* member;
+        bool has_empty;
+
+        header = interface->header;
+        has_empty = false;
+        for (uint32_t i = 0; i < header->n_slots; i++) {
+                symbol = &interface->symbols[i];
+                if (symbol->hash == 0) {
+                        has_empty = true;
+                        continue;
+                }
+
+                if (symbol->kind != NK_STRUCT && symbol->kind != NK_TYPE_ALIAS && symbol->kind != NK_PROCEDURE) {
+                        return false;
+                }
+
+                if (!in_strings(header, symbol->name, symbol->name_length)
+                        || !in_strings(header, symbol->type_name, symbol->type_length)
+                        || (uint64_t)symbol->first_member + symbol->n_members > header->n_members) {
+                        return false;
+                }
+        }
+
+        for (uint32_t i = 0; i < header->n_members; i++) {
+                member = &interface->members[i];
+                if (!in_strings(header, member->name, member->name_length) || !in_strings(header, member->type_name, member->type_length)) {
+                        return false;
+                }
+        }
+
+        /* Lookups stop at an empty slot */
+        return has_empty && in_strings(header, header->source_path, header->source_path_length);
+}
+
+bool interface_load(interface_t* interface, const char* filename)
+{
+        const interface_header_t* header;
+        uint64_t expected_size;
+        struct stat st;
+        int fd;
+
+        debug("Loading interface...");
+
+        interface->map = NULL;
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+                log_errno(filename);
+                return false;
+        }
+
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(interface_header_t)) {
+                fprintf(log_stderr(), "%s: not an interface file\n", filename);
+                close(fd);
+                return false;
+        }
+
+        /* Mapped, and read through once to check it */
+        interface->size = (size_t)st.st_size;
+        interface->map = mmap(NULL, interface->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (interface->map == MAP_FAILED) {
+                interface->map = NULL;
+                log_errno(filename);
+                return false;
+        }
+
+        header = interface->map;
+        if (memcmp(header->magic, INTERFACE_MAGIC, sizeof(header->magic)) != 0) {
+                fprintf(log_stderr(), "%s: not an interface file\n", filename);
+                interface_unload(interface);
+                return false;
+        }
+
+        if (header->version != INTERFACE_VERSION || header->word_bytes != sizeof(void*)) {
+                fprintf(log_stderr(), "%s: made by an incompatible compiler\n", filename);
+                interface_unload(interface);
+                return false;
+        }
+
+        expected_size = sizeof(interface_header_t)
+                + (uint64_t)header->n_slots * sizeof(interface_symbol_t)
+                + (uint64_t)header->n_members * sizeof(interface_member_t)
+                + header->strings_size;
+        if (header->n_slots == 0 || (header->n_slots & (header->n_slots - 1)) != 0 || expected_size != interface->size) {
+                fprintf(log_stderr(), "%s: corrupt interface file\n", filename);
+                interface_unload(interface);
+                return false;
+        }
+
+        interface->header = header;
+        interface->symbols = (const interface_symbol_t*)(header + 1);
+        interface->members = (const interface_member_t*)(interface->symbols + header->n_slots);
+        interface->strings = (const char*)(interface->members + header->n_members);
+
+        if (!check_records(interface)) {
+                fprintf(log_stderr(), "%s: corrupt interface file\n", filename);
+                interface_unload(interface);
+                return false;
+        }
+
+        if (!check_source(interface, filename)) {
+                interface_unload(interface);
+                return false;
+        }
+
+        return true;
+}
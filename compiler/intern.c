@@ -0,0 +1,178 @@
+/*
+ * String interning.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "lexer/keyword.h"
+#include "log.h"
+
+#define SHARED_TABLE_SIZE 64
+#define LOCAL_TABLE_SIZE  4096
+
+static interner_t shared;
+static _Thread_local interner_t* local;
+
+static symbol_t add_string(interner_t* interner, const char* string, size_t length, hash_t hash)
+{
+        interned_t* entry;
+        symbol_t symbol;
+
+        if (interner->count == interner->capacity) {
+                size_t capacity;
+                interned_t* strings;
+
+                capacity = interner->capacity * 2;
+                strings = realloc(interner->strings, capacity * sizeof(interned_t));
+                if (strings == NULL) {
+                        return SYMBOL_NONE;
+                }
+
+                interner->strings = strings;
+                interner->capacity = capacity;
+        }
+
+        /* Keep a copy so names outlive the source buffer */
+        entry = &interner->strings[interner->count];
+        entry->string = arena_alloc(&interner->arena, length + 1);
+        if (entry->string == NULL) {
+                return SYMBOL_NONE;
+        }
+        memcpy(entry->string, string, length);
+        entry->string[length] = '\0';
+        entry->length = (uint32_t)length;
+
+        symbol = interner->first + (symbol_t)interner->count;
+        if (!hashmap_add(&interner->table, entry->string, length, hash, (void*)(uintptr_t)symbol)) {
+                return SYMBOL_NONE;
+        }
+
+        interner->count++;
+        return symbol;
+}
+
+symbol_t intern(const char* string, size_t length, hash_t hash)
+{
+        void* value;
+
+        value = hashmap_find(&shared.table, string, length, hash);
+        if (value != NULL) {
+                return (symbol_t)(uintptr_t)value;
+        }
+
+        /* Only the shared interner exists until a thread binds its own */
+        if (local == NULL) {
+                return add_string(&shared, string, length, hash);
+        }
+
+        value = hashmap_find(&local->table, string, length, hash);
+        if (value != NULL) {
+                return (symbol_t)(uintptr_t)value;
+        }
+
+        return add_string(local, string, length, hash);
+}
+
+void symbol_name(symbol_t symbol, name_t* name)
+{
+        interned_t* entry;
+
+        if (local != NULL && symbol >= local->first) {
+                entry = &local->strings[symbol - local->first];
+        } else {
+                entry = &shared.strings[symbol];
+        }
+
+        name->string = entry->string;
+        name->length = entry->length;
+        name->symbol = symbol;
+}
+
+static bool init(interner_t* interner, size_t size, symbol_t first)
+{
+        arena_init(&interner->arena);
+        if (!hashmap_init(&interner->table, size, &interner->arena)) {
+                arena_destroy(&interner->arena);
+                return false;
+        }
+
+        interner->first = first;
+        interner->count = 0;
+        interner->capacity = size;
+        interner->strings = malloc(size * sizeof(interned_t));
+        if (interner->strings == NULL) {
+                arena_destroy(&interner->arena);
+                return false;
+        }
+
+        return true;
+}
+
+static void destroy(interner_t* interner)
+{
+        hashmap_destroy(&interner->table);
+        free(interner->strings);
+        arena_destroy(&interner->arena);
+        memset(interner, 0, sizeof(interner_t));
+}
+
+void interner_destroy(interner_t* interner)
+{
+        if (local == interner) {
+                local = NULL;
+        }
+
+        destroy(interner);
+}
+
+interner_t* interner_bind(interner_t* interner)
+{
+        interner_t* previous;
+
+        previous = local;
+        local = interner;
+        return previous;
+}
+
+bool interner_init(interner_t* interner)
+{
+        if (!init(interner, LOCAL_TABLE_SIZE, (symbol_t)shared.count)) {
+                return false;
+        }
+
+        local = interner;
+        return true;
+}
+
+void intern_destroy(void)
+{
+        destroy(&shared);
+}
+
+bool intern_init(void)
+{
+        debug("Initializing interner...");
+
+        if (!init(&shared, SHARED_TABLE_SIZE, 0)) {
+                return false;
+        }
+
+        /* Reserve SYMBOL_NONE */
+        shared.strings[0].string = "";
+        shared.strings[0].length = 0;
+        shared.count = 1;
+
+        /* Keywords come first, so their symbols are 1 to KEYWORD_COUNT */
+#define KEYWORD(string, kind) \
+        if (intern(string, sizeof(string) - 1, hash_data(string, sizeof(string) - 1)) == SYMBOL_NONE) { \
+                return false; \
+        }
+#include "lexer/keywords.def"
+#undef KEYWORD
+
+        return true;
+}
@@ -7,43 +7,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hash.h"
+#include "intern.h"
 #include "lexer.h"
 #include "lexer/char_info.h"
 #include "lexer/keyword.h"
+#include "lexer/scan.h"
 #include "log.h"
 
 static void skip_whitespace(lexer_t* lexer)
 {
-        while (char_info[(int)*lexer->pos] & CHAR_WHITESPACE) {
-                if (char_info[(int)*lexer->pos] & CHAR_VERT_WS) {
-                        lexer->line++;
-                        lexer->line_start = lexer->pos + 1;
-                }
-
-                lexer->pos++;
-        }
+        lexer->pos = scanner.whitespace(lexer->pos);
 }
 
 static void lex_identifier(lexer_t* lexer, token_t* token)
 {
-        keyword_t* keyword;
-
         /* Find end of identifier */
-        lexer->pos++;
-        while (char_info[(int)*lexer->pos] & CHAR_ALNUM || *lexer->pos == '_') {
-                lexer->pos++;
-        }
+        lexer->pos = scanner.identifier(lexer->pos + 1);
 
         /* Fill in token struct */
-        token->kind = TK_IDENTIFIER;
         token->length = (size_t)(lexer->pos - token->pos);
-        token->hash = hash_data(token->pos, token->length);
+        token->symbol = intern(token->pos, token->length, hash_padded(token->pos, token->length));
 
-        /* Look for a keyword the identifier matches */
-        keyword = keywords_find(token);
-        if (keyword != NULL) {
-                token->kind = keyword->value;
-        }
+        /* Keywords have the lowest symbols */
+        token->kind = keyword_kind(token->symbol);
 }
 
 static void lex_operator(lexer_t* lexer, token_t* token)
@@ -141,16 +127,20 @@ static void lex_number_base2(lexer_t* lexer, token_t* token)
 
 static void lex_string(lexer_t* lexer, token_t* token)
 {
-        /* Find end of string */
-        lexer->pos++;
-        while (*lexer->pos != '"') {
-                if (lexer->pos[0] == '\\' && lexer->pos[1] == '\"') {
+        /* Find end of string, stopping at escapes */
+        lexer->pos = scanner.quoted(lexer->pos + 1, '"');
+        while (*lexer->pos == '\\') {
+                if (lexer->pos[1] == '"') {
                         lexer->pos++;
                 }
 
+                lexer->pos = scanner.quoted(lexer->pos + 1, '"');
+        }
+
+        /* Unterminated strings end at the end of the source */
+        if (*lexer->pos == '"') {
                 lexer->pos++;
         }
-        lexer->pos++;
 
         token->kind = TK_STRING;
         token->length = (size_t)(lexer->pos - token->pos) - 1;
@@ -158,16 +148,20 @@ static void lex_string(lexer_t* lexer, token_t* token)
 
 static void lex_character(lexer_t* lexer, token_t* token)
 {
-        /* Find end of character */
-        lexer->pos++;
-        while (*lexer->pos != '\'') {
-                if (lexer->pos[0] == '\\' && lexer->pos[1] == '\'') {
+        /* Find end of character, stopping at escapes */
+        lexer->pos = scanner.quoted(lexer->pos + 1, '\'');
+        while (*lexer->pos == '\\') {
+                if (lexer->pos[1] == '\'') {
                         lexer->pos++;
                 }
 
+                lexer->pos = scanner.quoted(lexer->pos + 1, '\'');
+        }
+
+        /* Unterminated characters end at the end of the source */
+        if (*lexer->pos == '\'') {
                 lexer->pos++;
         }
-        lexer->pos++;
 
         token->kind = TK_CHARACTER;
         token->length = (size_t)(lexer->pos - token->pos) - 1;
@@ -183,8 +177,6 @@ void lexer_next(lexer_t* lexer, token_t* token)
 
         token->flags = TF_NONE;
         token->pos = lexer->pos;
-        token->line = lexer->line;
-        token->column = (int)(token->pos - lexer->line_start) + 1;
 
         if (char_info[(int)*lexer->pos] & CHAR_ALPHA || *lexer->pos == '_') {
                 lex_identifier(lexer, token);
@@ -230,10 +222,14 @@ void lexer_next(lexer_t* lexer, token_t* token)
 
         if (*lexer->pos == '\0') {
                 token->kind = TK_EOF;
+                token->length = 0;
                 return;
         }
 
+        /* Step over the character so lexing always makes progress */
         token->kind = TK_UNKNOWN;
+        token->length = 1;
+        lexer->pos++;
         return;
 }
 
@@ -242,8 +238,6 @@ void lexer_init(lexer_t* lexer, char* source)
         debug("Initializing lexer...");
 
         lexer->pos = source;
-        lexer->line_start = source;
-        lexer->line = 1;
 
-        keywords_init();
+        scanner_init();
 }
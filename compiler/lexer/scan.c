@@ -0,0 +1,215 @@
+/*
+ * Vectorized character scanning.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include "lexer/char_info.h"
+#include "lexer/scan.h"
+#include "log.h"
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+/*
+ * Scalar versions.
+ */
+
+static char* whitespace_scalar(char* pos)
+{
+        while (char_info[(uint8_t)*pos] & CHAR_WHITESPACE) {
+                pos++;
+        }
+
+        return pos;
+}
+
+static char* identifier_scalar(char* pos)
+{
+        while (char_info[(uint8_t)*pos] & CHAR_ALNUM || *pos == '_') {
+                pos++;
+        }
+
+        return pos;
+}
+
+/* Finds the next quote, backslash or NUL */
+static char* quoted_scalar(char* pos, char quote)
+{
+        while (*pos != quote && *pos != '\\' && *pos != '\0') {
+                pos++;
+        }
+
+        return pos;
+}
+
+#ifdef __x86_64__
+
+/*
+ * Bytes in [lo, hi] are found with one signed compare by shifting the
+ * range down to start at -128.
+ */
+#define IN_RANGE_128(v, lo, hi) \
+        _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - (lo)))), _mm_set1_epi8((char)(0x80 + (hi) - (lo) + 1)))
+#define IN_RANGE_256(v, lo, hi) \
+        _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (hi) - (lo) + 1)), _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - (lo)))))
+
+/*
+ * SSE2 versions (always available on x86-64).
+ */
+
+static char* whitespace_sse2(char* pos)
+{
+        for (;;) {
+                __m128i v, space;
+                uint32_t mask;
+
+                v = _mm_loadu_si128((__m128i*)pos);
+                space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+                space = _mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+                space = _mm_or_si128(space, IN_RANGE_128(v, '\n', '\f'));
+
+                mask = (uint32_t)_mm_movemask_epi8(space);
+                if (mask != 0xffff) {
+                        return pos + __builtin_ctz(~mask);
+                }
+
+                pos += 16;
+        }
+}
+
+static char* identifier_sse2(char* pos)
+{
+        for (;;) {
+                __m128i v, ident;
+                uint32_t mask;
+
+                v = _mm_loadu_si128((__m128i*)pos);
+                ident = _mm_or_si128(IN_RANGE_128(v, '0', '9'), IN_RANGE_128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'));
+                ident = _mm_or_si128(ident, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+                mask = (uint32_t)_mm_movemask_epi8(ident);
+                if (mask != 0xffff) {
+                        return pos + __builtin_ctz(~mask);
+                }
+
+                pos += 16;
+        }
+}
+
+static char* quoted_sse2(char* pos, char quote)
+{
+        for (;;) {
+                __m128i v, stop;
+                uint32_t mask;
+
+                v = _mm_loadu_si128((__m128i*)pos);
+                stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+                stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+
+                mask = (uint32_t)_mm_movemask_epi8(stop);
+                if (mask != 0) {
+                        return pos + __builtin_ctz(mask);
+                }
+
+                pos += 16;
+        }
+}
+
+/*
+ * AVX2 versions, selected at runtime.
+ */
+
+__attribute__((target("avx2")))
+static char* whitespace_avx2(char* pos)
+{
+        for (;;) {
+                __m256i v, space;
+                uint32_t mask;
+
+                v = _mm256_loadu_si256((__m256i*)pos);
+                space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+                space = _mm256_or_si256(space, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+                space = _mm256_or_si256(space, IN_RANGE_256(v, '\n', '\f'));
+
+                mask = (uint32_t)_mm256_movemask_epi8(space);
+                if (mask != ~0u) {
+                        return pos + __builtin_ctz(~mask);
+                }
+
+                pos += 32;
+        }
+}
+
+__attribute__((target("avx2")))
+static char* identifier_avx2(char* pos)
+{
+        for (;;) {
+                __m256i v, ident;
+                uint32_t mask;
+
+                v = _mm256_loadu_si256((__m256i*)pos);
+                ident = _mm256_or_si256(IN_RANGE_256(v, '0', '9'), IN_RANGE_256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'));
+                ident = _mm256_or_si256(ident, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+
+                mask = (uint32_t)_mm256_movemask_epi8(ident);
+                if (mask != ~0u) {
+                        return pos + __builtin_ctz(~mask);
+                }
+
+                pos += 32;
+        }
+}
+
+__attribute__((target("avx2")))
+static char* quoted_avx2(char* pos, char quote)
+{
+        for (;;) {
+                __m256i v, stop;
+                uint32_t mask;
+
+                v = _mm256_loadu_si256((__m256i*)pos);
+                stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+                stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+
+                mask = (uint32_t)_mm256_movemask_epi8(stop);
+                if (mask != 0) {
+                        return pos + __builtin_ctz(mask);
+                }
+
+                pos += 32;
+        }
+}
+
+#endif /* __x86_64__ */
+
+scanner_t scanner = { whitespace_scalar, identifier_scalar, quoted_scalar };
+
+static void select_scanner(void)
+{
+#ifdef __x86_64__
+        if (__builtin_cpu_supports("avx2")) {
+                debug("Using AVX2 scanner");
+                scanner.whitespace = whitespace_avx2;
+                scanner.identifier = identifier_avx2;
+                scanner.quoted = quoted_avx2;
+                return;
+        }
+
+        debug("Using SSE2 scanner");
+        scanner.whitespace = whitespace_sse2;
+        scanner.identifier = identifier_sse2;
+        scanner.quoted = quoted_sse2;
+#endif
+}
+
+void scanner_init(void)
+{
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+        /* Lexers on several threads share one selection */
+        pthread_once(&once, select_scanner);
+}
@@ -0,0 +1,229 @@
+/*
+ * Lexing on a thread of its own.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "hash.h"
+#include "lexer.h"
+#include "lexer/scan.h"
+#include "lexer/token_pipe.h"
+#include "log.h"
+
+/* Checks made before going to sleep, since the other side is rarely far off */
+#define PIPE_SPINS 128
+
+#define PIPE_MASK (TOKEN_PIPE_SIZE - 1)
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+}
+
+/* Sets index and wakes the other side if it is asleep on it */
+static void publish(atomic_uint* index, uint32_t value, atomic_bool* waiting)
+{
+        /* Both sequentially consistent, so one side always sees the other */
+        atomic_store(index, value);
+        if (atomic_load(waiting)) {
+                syscall(SYS_futex, index, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        }
+}
+
+/* Waits for the other side to move index on from old */
+static uint32_t wait_for(atomic_uint* index, uint32_t old, atomic_bool* waiting)
+{
+        uint32_t value;
+
+        for (int i = 0; i < PIPE_SPINS; i++) {
+                value = atomic_load_explicit(index, memory_order_acquire);
+                if (value != old) {
+                        return value;
+                }
+
+                cpu_relax();
+        }
+
+        for (;;) {
+                atomic_store(waiting, true);
+                value = atomic_load(index);
+                if (value == old) {
+                        syscall(SYS_futex, index, FUTEX_WAIT_PRIVATE, old, NULL, NULL, 0);
+                        value = atomic_load(index);
+                }
+                atomic_store(waiting, false);
+
+                if (value != old) {
+                        return value;
+                }
+        }
+}
+
+static void* lex_thread(void* arg)
+{
+        uint32_t tail, head, published;
+        token_pipe_t* pipe;
+        piped_token_t* slot;
+        lexer_t lexer;
+        token_t token;
+
+        pipe = arg;
+
+        /* Nothing is lexed without an interner, the parser just gets TK_EOF */
+        pipe->failed = !interner_init(&pipe->interner);
+        lexer.pos = pipe->source;
+        tail = 0;
+        head = 0;
+        published = 0;
+        do {
+                if (pipe->failed) {
+                        memset(&token, 0, sizeof(token_t));
+                        token.kind = TK_EOF;
+                        token.pos = pipe->source;
+                } else {
+                        lexer_next(&lexer, &token);
+                }
+
+                /* The parser's index is only looked at when the ring seems full */
+                if (tail - head == TOKEN_PIPE_SIZE) {
+                        head = atomic_load_explicit(&pipe->head, memory_order_acquire);
+                        if (tail - head == TOKEN_PIPE_SIZE) {
+                                publish(&pipe->tail, tail, &pipe->parser_waiting);
+                                published = tail;
+                                head = wait_for(&pipe->head, head, &pipe->lexer_waiting);
+                        }
+                }
+
+                slot = &pipe->tokens[tail & PIPE_MASK];
+                slot->kind = (uint8_t)token.kind;
+                slot->flags = token.flags;
+                slot->offset = (uint32_t)(token.pos - pipe->source);
+                slot->length = (uint32_t)token.length;
+                if (token.kind == TK_NUMBER) {
+                        slot->value = token.value;
+                } else if (token.kind == TK_IDENTIFIER || token.kind >= TK_PUB) {
+                        slot->value = token.symbol;
+                } else {
+                        slot->value = 0;
+                }
+                tail++;
+
+                /* Tokens are handed over in batches to keep the indexes' cache lines still */
+                if (tail - published >= TOKEN_PIPE_BATCH || token.kind == TK_EOF) {
+                        publish(&pipe->tail, tail, &pipe->parser_waiting);
+                        published = tail;
+                }
+        } while (token.kind != TK_EOF);
+
+        return NULL;
+}
+
+size_t token_pipe_read(token_pipe_t* pipe, piped_token_t** tokens)
+{
+        uint32_t head, n;
+
+        head = atomic_load_explicit(&pipe->head, memory_order_relaxed);
+        if (pipe->tail_seen == head) {
+                pipe->tail_seen = wait_for(&pipe->tail, head, &pipe->parser_waiting);
+        }
+
+        /* Reads stop at the end of the ring, the rest comes next time */
+        n = pipe->tail_seen - head;
+        if (n > TOKEN_PIPE_SIZE - (head & PIPE_MASK)) {
+                n = TOKEN_PIPE_SIZE - (head & PIPE_MASK);
+        }
+
+        *tokens = &pipe->tokens[head & PIPE_MASK];
+        return n;
+}
+
+void token_pipe_release(token_pipe_t* pipe, size_t n)
+{
+        uint32_t head;
+
+        head = atomic_load_explicit(&pipe->head, memory_order_relaxed);
+        publish(&pipe->head, head + (uint32_t)n, &pipe->lexer_waiting);
+}
+
+symbol_t token_pipe_symbol(token_pipe_t* pipe, piped_token_t* token)
+{
+        size_t index, capacity;
+        symbol_t* symbols;
+        char* pos;
+
+        /* Keywords and builtin names are shared */
+        if (token->value < pipe->interner.first) {
+                return (symbol_t)token->value;
+        }
+
+        index = (size_t)(token->value - pipe->interner.first);
+        if (index >= pipe->max_symbols) {
+                capacity = pipe->max_symbols != 0 ? pipe->max_symbols * 2 : 1024;
+                while (capacity <= index) {
+                        capacity *= 2;
+                }
+
+                symbols = realloc(pipe->symbols, capacity * sizeof(symbol_t));
+                if (symbols == NULL) {
+                        return SYMBOL_NONE;
+                }
+
+                memset(symbols + pipe->max_symbols, 0, (capacity - pipe->max_symbols) * sizeof(symbol_t));
+                pipe->symbols = symbols;
+                pipe->max_symbols = capacity;
+        }
+
+        /* Interned again in order, so symbols match lexing on one thread */
+        if (pipe->symbols[index] == SYMBOL_NONE) {
+                pos = pipe->source + token->offset;
+                pipe->symbols[index] = intern(pos, token->length, hash_padded(pos, token->length));
+        }
+
+        return pipe->symbols[index];
+}
+
+void token_pipe_destroy(token_pipe_t* pipe)
+{
+        pthread_join(pipe->thread, NULL);
+        interner_destroy(&pipe->interner);
+        free(pipe->symbols);
+        free(pipe);
+}
+
+token_pipe_t* token_pipe_create(char* source)
+{
+        token_pipe_t* pipe;
+
+        debug("Starting lexer thread...");
+
+        pipe = aligned_alloc(_Alignof(token_pipe_t), sizeof(token_pipe_t));
+        if (pipe == NULL) {
+                return NULL;
+        }
+
+        atomic_init(&pipe->tail, 0);
+        atomic_init(&pipe->lexer_waiting, false);
+        pipe->failed = false;
+        atomic_init(&pipe->head, 0);
+        atomic_init(&pipe->parser_waiting, false);
+        pipe->tail_seen = 0;
+        pipe->symbols = NULL;
+        pipe->max_symbols = 0;
+        pipe->source = source;
+        memset(&pipe->interner, 0, sizeof(interner_t));
+
+        scanner_init();
+        if (pthread_create(&pipe->thread, NULL, lex_thread, pipe) != 0) {
+                free(pipe);
+                return NULL;
+        }
+
+        return pipe;
+}
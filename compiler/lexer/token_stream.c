@@ -0,0 +1,840 @@
+/*
+ * Pre-lexed token storage.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hash.h"
+#include "lexer.h"
+#include "lexer/char_info.h"
+#include "lexer/scan.h"
+#include "lexer/token_stream.h"
+#include "log.h"
+#include "pool.h"
+
+#define GROW_ARRAY(array, capacity) \
+        (((array) = realloc((array), (capacity) * sizeof(*(array)))) != NULL)
+
+typedef struct {
+        token_stream_t tokens;
+        interner_t interner; /* Numbers names as if the chunk came first */
+        char* start;         /* Guessed to be where a token starts */
+        char* end;           /* Start of the next chunk */
+        char* next;          /* First token at or after end */
+        bool status;
+} lex_chunk_t;
+
+typedef struct {
+        char* source;
+        lex_chunk_t* chunks;
+} lex_job_t;
+
+static bool grow(token_stream_t* tokens, size_t needed)
+{
+        size_t capacity;
+
+        capacity = tokens->capacity != 0 ? tokens->capacity * 2 : 1024;
+        while (capacity < needed) {
+                capacity *= 2;
+        }
+
+        if (!GROW_ARRAY(tokens->kinds, capacity)
+                || !GROW_ARRAY(tokens->flags, capacity)
+                || !GROW_ARRAY(tokens->offsets, capacity)
+                || !GROW_ARRAY(tokens->lengths, capacity)
+                || !GROW_ARRAY(tokens->values, capacity)) {
+                return false;
+        }
+
+        tokens->capacity = capacity;
+        return true;
+}
+
+/* Moves the tokens from keep on to the front, along with the lines they are on */
+static void drop_tokens(token_stream_t* tokens)
+{
+        size_t dropped, held, line;
+
+        dropped = tokens->keep - tokens->first;
+        held = tokens->count - tokens->keep;
+        memmove(tokens->kinds, tokens->kinds + dropped, held * sizeof(*tokens->kinds));
+        memmove(tokens->flags, tokens->flags + dropped, held * sizeof(*tokens->flags));
+        memmove(tokens->offsets, tokens->offsets + dropped, held * sizeof(*tokens->offsets));
+        memmove(tokens->lengths, tokens->lengths + dropped, held * sizeof(*tokens->lengths));
+        memmove(tokens->values, tokens->values + dropped, held * sizeof(*tokens->values));
+        tokens->first = tokens->keep;
+
+        /* The line the first kept token is on stays */
+        line = 0;
+        while (line + 1 < tokens->n_lines && tokens->line_tokens[line + 1] <= tokens->first) {
+                line++;
+        }
+
+        if (line != 0) {
+                memmove(tokens->line_offsets, tokens->line_offsets + line, (tokens->n_lines - line) * sizeof(*tokens->line_offsets));
+                memmove(tokens->line_tokens, tokens->line_tokens + line, (tokens->n_lines - line) * sizeof(*tokens->line_tokens));
+                tokens->n_lines -= line;
+                tokens->first_line += line;
+        }
+}
+
+/* Makes room for n more tokens, dropping the ones that are done with before growing */
+static bool make_room(token_stream_t* tokens, size_t n)
+{
+        size_t held;
+
+        held = tokens->count - tokens->first;
+        if (held + n <= tokens->capacity) {
+                return true;
+        }
+
+        /* Moving the rest down is only worth it once that frees half the arrays */
+        if (tokens->keep - tokens->first != 0 && tokens->keep - tokens->first >= tokens->capacity / 2) {
+                held -= tokens->keep - tokens->first;
+                drop_tokens(tokens);
+        }
+
+        return held + n <= tokens->capacity || grow(tokens, held + n);
+}
+
+static bool push_token(token_stream_t* tokens, token_t* token, uint32_t offset)
+{
+        size_t i;
+
+        if (!make_room(tokens, 1)) {
+                return false;
+        }
+
+        i = tokens->count++ - tokens->first;
+        tokens->kinds[i] = (uint8_t)token->kind;
+        tokens->flags[i] = token->flags;
+        tokens->offsets[i] = offset;
+        tokens->lengths[i] = (uint32_t)token->length;
+
+        /* Other tokens have no value */
+        if (token->kind == TK_NUMBER) {
+                tokens->values[i] = token->value;
+        } else if (token->kind == TK_IDENTIFIER || token->kind >= TK_PUB) {
+                tokens->values[i] = token->symbol;
+        } else {
+                tokens->values[i] = 0;
+        }
+
+        return true;
+}
+
+static bool add_line(token_stream_t* tokens, uint32_t offset, token_id_t first)
+{
+        size_t capacity;
+
+        if (tokens->n_lines == tokens->max_lines) {
+                capacity = tokens->max_lines != 0 ? tokens->max_lines * 2 : 256;
+                if (!GROW_ARRAY(tokens->line_offsets, capacity) || !GROW_ARRAY(tokens->line_tokens, capacity)) {
+                        return false;
+                }
+
+                tokens->max_lines = capacity;
+        }
+
+        tokens->line_offsets[tokens->n_lines] = offset;
+        tokens->line_tokens[tokens->n_lines] = first;
+        tokens->n_lines++;
+        return true;
+}
+
+/*
+ * Adds the lines that start in size bytes of source at base. *next is
+ * the first token not known to start before data, and is left at the
+ * first token after the last line start.
+ */
+static bool add_lines(token_stream_t* tokens, const char* data, size_t size, uint64_t base, token_id_t* next)
+{
+        const char* end;
+        const char* pos;
+        uint32_t start;
+
+        if (tokens->n_lines == 0 && !add_line(tokens, 0, 0)) {
+                return false;
+        }
+
+        /* Dropped tokens were all lexed from earlier data */
+        if (*next < tokens->first) {
+                *next = tokens->first;
+        }
+
+        end = data + size;
+        for (pos = memchr(data, '\n', size); pos != NULL; pos = memchr(pos, '\n', (size_t)(end - pos))) {
+                pos++;
+                start = (uint32_t)(base + (uint64_t)(pos - data));
+
+                /* Offsets wrap past 4 GiB, but nearby ones still compare by their difference */
+                while (*next < tokens->count && (int32_t)(tokens->offsets[token_index(tokens, *next)] - start) < 0) {
+                        (*next)++;
+                }
+
+                if (!add_line(tokens, start, *next)) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+void token_location(token_stream_t* tokens, token_id_t id, int* line, int* column)
+{
+        size_t low, high, mid;
+        uint32_t offset;
+        char* end;
+        char* pos;
+
+        offset = tokens->offsets[token_index(tokens, id)];
+
+        /* Sources in memory are scanned for lines on from the last location asked for */
+        if (tokens->source != NULL) {
+                if (offset < tokens->scanned) {
+                        tokens->scanned = 0;
+                        tokens->scanned_line_start = 0;
+                        tokens->scanned_lines = 0;
+                }
+
+                pos = tokens->source + tokens->scanned;
+                end = tokens->source + offset;
+                while (pos < end && (pos = memchr(pos, '\n', (size_t)(end - pos))) != NULL) {
+                        pos++;
+                        tokens->scanned_line_start = (uint32_t)(pos - tokens->source);
+                        tokens->scanned_lines++;
+                }
+
+                tokens->scanned = offset;
+                *line = (int)tokens->scanned_lines + 1;
+                *column = (int)(offset - tokens->scanned_line_start) + 1;
+                return;
+        }
+
+        if (tokens->n_lines == 0) {
+                *line = 1;
+                *column = (int)offset + 1;
+                return;
+        }
+
+        /* The line is the last one whose first token is not after this one */
+        low = 0;
+        high = tokens->n_lines;
+        while (high - low > 1) {
+                mid = low + (high - low) / 2;
+                if (tokens->line_tokens[mid] <= id) {
+                        low = mid;
+                } else {
+                        high = mid;
+                }
+        }
+
+        *line = (int)(tokens->first_line + low) + 1;
+        *column = (int)(offset - tokens->line_offsets[low]) + 1;
+}
+
+/*
+ * Lexes the tokens that start between start and end, stopping early at
+ * the end of the source. *next is left at the first token not pushed.
+ */
+static bool lex_range(token_stream_t* tokens, char* source, char* start, char* end, char** next)
+{
+        lexer_t lexer;
+        token_t token;
+
+        lexer.pos = start;
+        for (;;) {
+                lexer_next(&lexer, &token);
+                if (token.pos >= end) {
+                        *next = token.pos;
+                        return true;
+                }
+
+                if (!push_token(tokens, &token, (uint32_t)(token.pos - source))) {
+                        return false;
+                }
+
+                if (token.kind == TK_EOF) {
+                        *next = end;
+                        return true;
+                }
+        }
+}
+
+static bool starts_declaration(const char* line)
+{
+        size_t length;
+
+        if (strncmp(line, "proc", 4) == 0 || strncmp(line, "type", 4) == 0) {
+                length = 4;
+        } else if (strncmp(line, "pub", 3) == 0) {
+                length = 3;
+        } else {
+                return false;
+        }
+
+        return !(char_info[(unsigned char)line[length]] & CHAR_ALNUM) && line[length] != '_';
+}
+
+/* First line after pos that looks like it starts a top-level declaration */
+static char* find_split(char* pos, char* end)
+{
+        while ((pos = memchr(pos, '\n', (size_t)(end - pos))) != NULL) {
+                pos++;
+                if (starts_declaration(pos)) {
+                        return pos;
+                }
+        }
+
+        return NULL;
+}
+
+static void lex_chunk(void* context, size_t index)
+{
+        interner_t* previous;
+        lex_chunk_t* chunk;
+        lex_job_t* job;
+
+        job = context;
+        chunk = &job->chunks[index];
+
+        /* The calling thread lexes too, and must get its own interner back */
+        previous = interner_bind(NULL);
+        chunk->status = interner_init(&chunk->interner)
+                && lex_range(&chunk->tokens, job->source, chunk->start, chunk->end, &chunk->next);
+        interner_bind(previous);
+}
+
+/*
+ * Appends a chunk's tokens from first on, giving their names the
+ * symbols serial lexing would.
+ */
+static bool append_chunk(token_stream_t* tokens, lex_chunk_t* chunk, size_t first)
+{
+        token_stream_t* src;
+        symbol_t* symbols;
+        symbol_t symbol;
+        size_t n, count;
+        char* pos;
+
+        src = &chunk->tokens;
+        count = src->count - first;
+        if (tokens->count + count > tokens->capacity && !grow(tokens, tokens->count + count)) {
+                return false;
+        }
+
+        symbols = calloc(chunk->interner.count + 1, sizeof(symbol_t));
+        if (symbols == NULL) {
+                return false;
+        }
+
+        n = tokens->count;
+        memcpy(tokens->kinds + n, src->kinds + first, count * sizeof(*src->kinds));
+        memcpy(tokens->flags + n, src->flags + first, count * sizeof(*src->flags));
+        memcpy(tokens->offsets + n, src->offsets + first, count * sizeof(*src->offsets));
+        memcpy(tokens->lengths + n, src->lengths + first, count * sizeof(*src->lengths));
+        memcpy(tokens->values + n, src->values + first, count * sizeof(*src->values));
+        tokens->count += count;
+
+        /* Names are interned again in source order, the first time each is seen */
+        for (size_t i = n; i < tokens->count; i++) {
+                if (tokens->kinds[i] != TK_IDENTIFIER || tokens->values[i] < chunk->interner.first) {
+                        continue;
+                }
+
+                symbol = (symbol_t)tokens->values[i] - chunk->interner.first;
+                if (symbols[symbol] == SYMBOL_NONE) {
+                        pos = tokens->source + tokens->offsets[i];
+                        symbols[symbol] = intern(pos, tokens->lengths[i], hash_padded(pos, tokens->lengths[i]));
+                }
+
+                tokens->values[i] = symbols[symbol];
+        }
+
+        free(symbols);
+        return true;
+}
+
+/*
+ * Lexes a chunk's part of the source again from pos, until a token
+ * starts where one of the chunk's did. Lexing only depends on where a
+ * token starts, so the chunk's tokens from there on are used as is.
+ */
+static bool relex_chunk(token_stream_t* tokens, lex_chunk_t* chunk, char* pos, char** next)
+{
+        uint32_t offset;
+        lexer_t lexer;
+        token_t token;
+        size_t i;
+
+        i = 0;
+        lexer.pos = pos;
+        for (;;) {
+                lexer_next(&lexer, &token);
+                if (token.pos >= chunk->end) {
+                        *next = token.pos;
+                        return true;
+                }
+
+                offset = (uint32_t)(token.pos - tokens->source);
+                while (i < chunk->tokens.count && chunk->tokens.offsets[i] < offset) {
+                        i++;
+                }
+
+                if (i < chunk->tokens.count && chunk->tokens.offsets[i] == offset) {
+                        *next = chunk->next;
+                        return append_chunk(tokens, chunk, i);
+                }
+
+                if (!push_token(tokens, &token, offset)) {
+                        return false;
+                }
+
+                if (token.kind == TK_EOF) {
+                        *next = chunk->end;
+                        return true;
+                }
+        }
+}
+
+/*
+ * Joins the chunks in order. A chunk only fits if the one before it
+ * stopped exactly where it starts; otherwise its guess was wrong (it
+ * started inside a string, say) and it is lexed again from where the
+ * previous chunk stopped until the two line up.
+ */
+static bool join_chunks(token_stream_t* tokens, lex_chunk_t* chunks, size_t n_chunks)
+{
+        char* next;
+
+        next = tokens->source;
+        for (size_t i = 0; i < n_chunks; i++) {
+                if (!chunks[i].status) {
+                        return false;
+                }
+
+                if (next == chunks[i].start) {
+                        if (!append_chunk(tokens, &chunks[i], 0)) {
+                                return false;
+                        }
+
+                        next = chunks[i].next;
+                } else {
+                        debug("Relexing chunk...");
+                        if (!relex_chunk(tokens, &chunks[i], next, &next)) {
+                                return false;
+                        }
+                }
+
+                /* Everything after a zero byte is ignored */
+                if (tokens->kinds[tokens->count - 1] == TK_EOF) {
+                        break;
+                }
+        }
+
+        return true;
+}
+
+static bool lex_parallel(token_stream_t* tokens, size_t size, size_t n_chunks, size_t n_threads)
+{
+        lex_chunk_t* chunks;
+        lex_job_t job;
+        char* start;
+        char* end;
+        size_t n;
+        bool status;
+
+        chunks = calloc(n_chunks, sizeof(lex_chunk_t));
+        if (chunks == NULL) {
+                return false;
+        }
+
+        /* Split near equal sizes, at what looks like the start of a declaration */
+        end = tokens->source + size;
+        start = tokens->source;
+        n = 0;
+        for (size_t i = 1; i <= n_chunks; i++) {
+                chunks[n].start = start;
+                start = i < n_chunks ? find_split(tokens->source + size / n_chunks * i, end) : NULL;
+                if (start == NULL) {
+                        /* Past the end, so the zero byte there is lexed as TK_EOF */
+                        chunks[n++].end = end + 1;
+                        break;
+                }
+
+                if (start > chunks[n].start) {
+                        chunks[n++].end = start;
+                } else {
+                        start = chunks[n].start;
+                }
+        }
+
+        job.source = tokens->source;
+        job.chunks = chunks;
+        status = pool_run(n_threads, n, lex_chunk, &job) && join_chunks(tokens, chunks, n);
+
+        for (size_t i = 0; i < n; i++) {
+                interner_destroy(&chunks[i].interner);
+                tokens_destroy(&chunks[i].tokens);
+        }
+
+        free(chunks);
+        return status;
+}
+
+bool tokens_lex(token_stream_t* tokens, const char* filename, char* source, size_t size, size_t n_threads)
+{
+        size_t n_chunks;
+        char* next;
+        bool status;
+
+        debug("Lexing...");
+
+        memset(tokens, 0, sizeof(token_stream_t));
+        tokens->source = source;
+        tokens->filename = filename;
+
+        scanner_init();
+        n_chunks = size / LEX_CHUNK_MIN_SIZE < n_threads ? size / LEX_CHUNK_MIN_SIZE : n_threads;
+        if (n_chunks > 1) {
+                status = lex_parallel(tokens, size, n_chunks, n_threads);
+        } else {
+                status = lex_range(tokens, source, source, source + size + 1, &next);
+        }
+
+        if (!status) {
+                tokens_destroy(tokens);
+        }
+
+        return status;
+}
+
+/* Stops the stream where it is, the parser sees TK_EOF there */
+static void cut_short(token_stream_t* tokens)
+{
+        tokens->failed = true;
+        if (tokens->count != tokens->first) {
+                tokens->kinds[token_index(tokens, tokens->count - 1)] = TK_EOF;
+        }
+}
+
+static void pull_piped(token_stream_t* tokens)
+{
+        piped_token_t* src;
+        size_t n, i;
+        bool eof;
+
+        n = token_pipe_read(tokens->pipe, &src);
+
+        /* Tokens are dropped after a failure, but the lexer still has to reach TK_EOF */
+        if (!tokens->failed && !make_room(tokens, n)) {
+                cut_short(tokens);
+        }
+
+        if (!tokens->failed) {
+                for (i = token_index(tokens, tokens->count); i < token_index(tokens, tokens->count + n); i++) {
+                        tokens->kinds[i] = src->kind;
+                        tokens->flags[i] = src->flags;
+                        tokens->offsets[i] = src->offset;
+                        tokens->lengths[i] = src->length;
+                        tokens->values[i] = src->kind == TK_IDENTIFIER ? token_pipe_symbol(tokens->pipe, src) : src->value;
+                        src++;
+                }
+
+                tokens->count += n;
+        } else {
+                src += n;
+        }
+
+        /* Slots can be written again as soon as they are released */
+        eof = src[-1].kind == TK_EOF;
+        token_pipe_release(tokens->pipe, n);
+        if (eof) {
+                tokens->failed = tokens->failed || tokens->pipe->failed;
+                token_pipe_destroy(tokens->pipe);
+                tokens->pipe = NULL;
+                tokens->pending = false;
+        }
+}
+
+bool tokens_lex_piped(token_stream_t* tokens, const char* filename, char* source)
+{
+        debug("Lexing on another thread...");
+
+        memset(tokens, 0, sizeof(token_stream_t));
+        tokens->source = source;
+        tokens->filename = filename;
+
+        tokens->pipe = token_pipe_create(source);
+        if (tokens->pipe == NULL) {
+                return false;
+        }
+
+        tokens->pending = true;
+
+        /* The parser always has a current token */
+        tokens_pull(tokens);
+        if (tokens->failed) {
+                tokens_destroy(tokens);
+                return false;
+        }
+
+        return true;
+}
+
+/* Reads until the window is full or the input ends */
+static bool fill_window(int fd, char* window, size_t* size, size_t capacity, bool* eof)
+{
+        ssize_t n;
+
+        while (*size < capacity) {
+                n = read(fd, window + *size, capacity - *size);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n < 0) {
+                        return false;
+                }
+                if (n == 0) {
+                        *eof = true;
+                        break;
+                }
+
+                *size += (size_t)n;
+        }
+
+        return true;
+}
+
+/*
+ * Lexes the window and returns how much of it was used. Unless the input
+ * has ended, the token that runs into the end of the window may continue
+ * past it, so it is left for the next window.
+ */
+static size_t lex_window(token_stream_t* tokens, char* window, size_t size, uint64_t base, bool last, bool* status)
+{
+        lexer_t lexer;
+        token_t token;
+
+        lexer.pos = window;
+        for (;;) {
+                lexer_next(&lexer, &token);
+                if (!last && lexer.pos >= window + size) {
+                        return (size_t)(token.pos - window);
+                }
+
+                if (!push_token(tokens, &token, (uint32_t)(base + (uint64_t)(token.pos - window)))) {
+                        *status = false;
+                        return 0;
+                }
+
+                if (token.kind == TK_EOF) {
+                        return size;
+                }
+        }
+}
+
+static void end_window(token_stream_t* tokens)
+{
+        close(tokens->window->fd);
+        free(tokens->window->data);
+        free(tokens->window);
+        tokens->window = NULL;
+        tokens->pending = false;
+}
+
+/* Lexes windows of the input until one has tokens in it or the input ends */
+static void pull_window(token_stream_t* tokens)
+{
+        token_window_t* window;
+        size_t count, used;
+        bool status;
+        char* grown;
+
+        window = tokens->window;
+        count = tokens->count;
+        status = true;
+        while (tokens->count == count) {
+                if (!fill_window(window->fd, window->data, &window->size, window->capacity, &window->eof)) {
+                        status = false;
+                        break;
+                }
+
+                memset(window->data + window->size, 0, 1 + LEXER_PADDING);
+                used = lex_window(tokens, window->data, window->size, window->base, window->eof, &status);
+
+                /* The source is dropped as it goes, so its lines are found now */
+                if (!status || !add_lines(tokens, window->data, used, window->base, &window->next_line)) {
+                        status = false;
+                        break;
+                }
+
+                if (window->on_window != NULL) {
+                        window->on_window(window->context, window->data, used);
+                }
+
+                if (window->eof) {
+                        break;
+                }
+
+                /* A token longer than the window needs a bigger one */
+                if (used == 0) {
+                        grown = realloc(window->data, window->capacity * 2 + 1 + LEXER_PADDING);
+                        if (grown == NULL) {
+                                status = false;
+                                break;
+                        }
+
+                        window->data = grown;
+                        window->capacity *= 2;
+                        continue;
+                }
+
+                memmove(window->data, window->data + used, window->size - used);
+                window->size -= used;
+                window->base += used;
+        }
+
+        if (!status) {
+                cut_short(tokens);
+        }
+
+        if (!status || window->eof) {
+                end_window(tokens);
+        }
+}
+
+static void pull_source(token_stream_t* tokens)
+{
+        lexer_t lexer;
+        token_t token;
+
+        lexer.pos = tokens->next;
+        for (size_t i = 0; i < LEX_BATCH_SIZE; i++) {
+                lexer_next(&lexer, &token);
+                if (!push_token(tokens, &token, (uint32_t)(token.pos - tokens->source))) {
+                        cut_short(tokens);
+                        break;
+                }
+
+                if (token.kind == TK_EOF) {
+                        break;
+                }
+        }
+
+        if (tokens->failed || token.kind == TK_EOF) {
+                tokens->next = NULL;
+                tokens->pending = false;
+                return;
+        }
+
+        tokens->next = lexer.pos;
+}
+
+void tokens_pull(token_stream_t* tokens)
+{
+        if (tokens->pipe != NULL) {
+                pull_piped(tokens);
+        } else if (tokens->window != NULL) {
+                pull_window(tokens);
+        } else if (tokens->next != NULL) {
+                pull_source(tokens);
+        }
+}
+
+/* Lexes whatever is left without keeping it, and says whether anything went wrong */
+bool tokens_finish(token_stream_t* tokens)
+{
+        while (tokens->pending) {
+                tokens_drop(tokens, tokens->count);
+                tokens_pull(tokens);
+        }
+
+        return !tokens->failed;
+}
+
+bool tokens_lex_lazy(token_stream_t* tokens, const char* filename, char* source)
+{
+        debug("Lexing as needed...");
+
+        memset(tokens, 0, sizeof(token_stream_t));
+        tokens->source = source;
+        tokens->next = source;
+        tokens->filename = filename;
+        tokens->pending = true;
+
+        /* The parser always has a current token */
+        scanner_init();
+        pull_source(tokens);
+        if (tokens->failed) {
+                tokens_destroy(tokens);
+                return false;
+        }
+
+        return true;
+}
+
+bool tokens_lex_stream(token_stream_t* tokens, const char* filename, int fd, window_handler_t on_window, void* context)
+{
+        token_window_t* window;
+
+        debug("Lexing stream...");
+
+        memset(tokens, 0, sizeof(token_stream_t));
+        tokens->filename = filename;
+
+        window = calloc(1, sizeof(token_window_t));
+        if (window == NULL) {
+                close(fd);
+                return false;
+        }
+
+        window->capacity = STREAM_WINDOW_SIZE;
+        window->data = malloc(window->capacity + 1 + LEXER_PADDING);
+        if (window->data == NULL) {
+                free(window);
+                close(fd);
+                return false;
+        }
+
+        window->fd = fd;
+        window->on_window = on_window;
+        window->context = context;
+        tokens->window = window;
+        tokens->pending = true;
+
+        /* The parser always has a current token */
+        scanner_init();
+        pull_window(tokens);
+        if (tokens->failed) {
+                tokens_destroy(tokens);
+                return false;
+        }
+
+        return true;
+}
+
+void tokens_destroy(token_stream_t* tokens)
+{
+        /* The lexer thread has to be done with the source */
+        if (tokens->pipe != NULL) {
+                tokens_finish(tokens);
+        }
+
+        if (tokens->window != NULL) {
+                end_window(tokens);
+        }
+
+        free(tokens->kinds);
+        free(tokens->flags);
+        free(tokens->offsets);
+        free(tokens->lengths);
+        free(tokens->values);
+        free(tokens->line_offsets);
+        free(tokens->line_tokens);
+        memset(tokens, 0, sizeof(token_stream_t));
+}
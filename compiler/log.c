@@ -4,33 +4,84 @@
  * Provided under the BSD 3-Clause license.
  */
 
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "log.h"
 
+static _Thread_local FILE* redirect_out;
+static _Thread_local FILE* redirect_err;
+
+void log_redirect(FILE* out, FILE* err)
+{
+        redirect_out = out;
+        redirect_err = err;
+}
+
+FILE* log_stdout(void)
+{
+        return redirect_out != NULL ? redirect_out : stdout;
+}
+
+FILE* log_stderr(void)
+{
+        return redirect_err != NULL ? redirect_err : stderr;
+}
+
+void log_errno(const char* prefix)
+{
+        fprintf(log_stderr(), "%s: %s\n", prefix, strerror(errno));
+}
+
 void __debug(const char* func, const char* msg)
 {
         printf("%s(): \033[90mdebug\033[0m: %s\n", func, msg);
 }
 
-void error(token_t* token, const char* fmt, ...)
+void error(token_stream_t* tokens, token_id_t token, const char* fmt, ...)
 {
+        int line, column;
         va_list ap;
+        FILE* file;
+
+        token_location(tokens, token, &line, &column);
+
+        /* Keep messages from different threads whole */
+        file = log_stderr();
+        flockfile(file);
 
-        fprintf(stderr, "%d:%d: \033[91merror\033[0m: ", token->line, token->column);
+        if (tokens->filename != NULL) {
+                fprintf(file, "%s:", tokens->filename);
+        }
+        fprintf(file, "%d:%d: \033[91merror\033[0m: ", line, column);
 
         va_start(ap, fmt);
-        vfprintf(stderr, fmt, ap);
+        vfprintf(file, fmt, ap);
         va_end(ap);
+
+        funlockfile(file);
 }
 
-void warn(token_t* token, const char* fmt, ...)
+void warn(token_stream_t* tokens, token_id_t token, const char* fmt, ...)
 {
+        int line, column;
         va_list ap;
+        FILE* file;
+
+        token_location(tokens, token, &line, &column);
 
-        printf("%d:%d: \033[93mwarning\033[0m: ", token->line, token->column);
+        file = log_stdout();
+        flockfile(file);
+
+        if (tokens->filename != NULL) {
+                fprintf(file, "%s:", tokens->filename);
+        }
+        fprintf(file, "%d:%d: \033[93mwarning\033[0m: ", line, column);
 
         va_start(ap, fmt);
-        vprintf(fmt, ap);
+        vfprintf(file, fmt, ap);
         va_end(ap);
+
+        funlockfile(file);
 }
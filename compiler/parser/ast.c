@@ -4,87 +4,161 @@
  * Provided under the BSD 3-Clause license.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include "log.h"
 #include "name.h"
 #include "parser/ast.h"
 
-ast_node_t* create_node(ast_node_t* parent)
+const char* node_kind_strings[NK_COUNT] = {
+        [NK_UNKNOWN] = "unknown",
+        [NK_BUILTIN_TYPE] = "built-in type",
+        [NK_TYPE_ALIAS] = "alias type",
+        [NK_STRUCT] = "structure type",
+        [NK_STRUCT_MEMBER] = "member",
+        [NK_PROCEDURE] = "procedure",
+        [NK_PARAMETER] = "parameter",
+        [NK_CALL] = "call",
+        [NK_RETURN] = "return",
+        [NK_IF] = "if",
+        [NK_CONDITIONS] = "conditions",
+        [NK_LOCAL_VARIABLE] = "local variable",
+        [NK_VARIABLE_REFERENCE] = "variable reference",
+        [NK_NUMBER] = "number"
+};
+
+static bool add_chunk(ast_t* ast)
+{
+        ast_node_t* chunk;
+
+        /* Grow chunk table if needed */
+        if (ast->n_chunks == ast->max_chunks) {
+                ast_node_t** chunks;
+                size_t max_chunks;
+
+                max_chunks = ast->max_chunks != 0 ? ast->max_chunks * 2 : 16;
+                chunks = realloc(ast->chunks, max_chunks * sizeof(ast_node_t*));
+                if (chunks == NULL) {
+                        return false;
+                }
+
+                ast->chunks = chunks;
+                ast->max_chunks = max_chunks;
+        }
+
+        chunk = arena_alloc(ast->arena, AST_CHUNK_NODES * sizeof(ast_node_t));
+        if (chunk == NULL) {
+                return false;
+        }
+
+        ast->chunks[ast->n_chunks++] = chunk;
+        return true;
+}
+
+ast_node_t* create_node(ast_t* ast, ast_node_t* parent)
 {
         ast_node_t* node;
 
-        node = malloc(sizeof(ast_node_t));
+        /* Chunks are kept around after nodes are deleted */
+        if ((ast->n_nodes >> AST_CHUNK_SHIFT) == ast->n_chunks && !add_chunk(ast)) {
+                return NULL;
+        }
+
+        node = get_node(ast, ast->n_nodes);
+        node->id = ast->n_nodes++;
         node->kind = NK_UNKNOWN;
         node->flags = NF_NONE;
-        node->parent = parent;
-        node->children.head = NULL;
-        node->children.tail = NULL;
-        node->next = NULL;
+        node->parent = parent != NULL ? parent->id : NODE_NONE;
+        node->children.head = NODE_NONE;
+        node->children.tail = NODE_NONE;
+        node->next = NODE_NONE;
+        node->type = NODE_NONE;
 
         return node;
 }
 
-void push_node(ast_node_t* node, ast_node_list_t* list)
+void push_node(ast_t* ast, ast_node_t* node, ast_node_list_t* list)
 {
         if (list == NULL) {
-                list = &node->parent->children;
+                list = &get_node(ast, node->parent)->children;
         }
 
-        /* Add the node to the doubly linked list */
-        if (list->head == NULL) {
-                node->prev = NULL;
-                list->head = node;
+        /* Add the node to the linked list */
+        if (list->head == NODE_NONE) {
+                list->head = node->id;
         } else {
-                node->prev = list->tail;
-                list->tail->next = node;
+                get_node(ast, list->tail)->next = node->id;
         }
 
-        list->tail = node;
+        list->tail = node->id;
 }
 
-void delete_nodes(ast_node_t* top_node)
+node_id_t first_deletable(ast_t* ast, node_id_t id)
 {
-        ast_node_t* node;
-        ast_node_t* next;
-
-        node = top_node;
-        while (node != NULL) {
-                /* Descend if not already visited */
-                if (node->kind != NK_UNKNOWN && node->children.head != NULL) {
-                        node->kind = NK_UNKNOWN;
-                        node = node->children.head;
-                        continue;
-                }
+        /*
+         * Pinned nodes (imports) can be created in the middle of
+         * another declaration, so the rest of that subtree is left
+         * unlinked in the pool.
+         */
+        if (id > ast->pinned) {
+                return id;
+        }
 
-                /* Free top node and exit */
-                if (node == top_node) {
-                        free(node);
-                        return;
-                }
+        return ast->pinned + 1;
+}
 
-                /* Go to nearest sibling or parent */
-                if (node->next != NULL) {
-                        next = node->next;
-                } else if (node->parent != NULL) {
-                        next = node->parent;
-                }
-                free(node);
-                node = next;
-        }
+void delete_nodes(ast_t* ast, ast_node_t* top_node)
+{
+        /*
+         * Nodes are allocated depth-first, so everything allocated
+         * after top_node belongs to its (unfinished) subtree, unless
+         * it was pinned.
+         */
+        ast->n_nodes = first_deletable(ast, top_node->id);
 }
 
-ast_node_t* find_node(token_t* name, ast_node_t* parent)
+void release_nodes(ast_t* ast, ast_node_t* parent, node_id_t first)
 {
-        /* Search all scopes for node */
-        for (ast_node_t* scope = parent; scope != NULL; scope = scope->parent) {
-                for (ast_node_t* node = scope->children.head; node != NULL; node = node->next) {
-                        if (node->flags & NF_NAMED && node->name.hash == name->hash && node->name.length == name->length) {
-                                return node;
-                        }
-                }
+        ast_node_t* child;
+        node_id_t tail;
+
+        /* Children are linked in the order they were created */
+        tail = NODE_NONE;
+        for (node_id_t id = parent->children.head; id != NODE_NONE && id < first; id = child->next) {
+                child = get_node(ast, id);
+                tail = id;
         }
 
-        /* Node not found */
-        return NULL;
+        if (tail == NODE_NONE) {
+                parent->children.head = NODE_NONE;
+        } else {
+                get_node(ast, tail)->next = NODE_NONE;
+        }
+
+        parent->children.tail = tail;
+        ast->n_nodes = first_deletable(ast, first);
+}
+
+void ast_destroy(ast_t* ast)
+{
+        /* The chunks themselves belong to the arena */
+        free(ast->chunks);
+        ast->chunks = NULL;
+        ast->n_chunks = 0;
+        ast->max_chunks = 0;
+        ast->n_nodes = 0;
+}
+
+void ast_init(ast_t* ast, arena_t* arena)
+{
+        ast->arena = arena;
+        ast->chunks = NULL;
+        ast->n_chunks = 0;
+        ast->max_chunks = 0;
+        ast->n_nodes = 0;
+        ast->pinned = 0;
+
+        /* Reserve node 0 so that NODE_NONE never refers to a real node */
+        create_node(ast, NULL);
 }
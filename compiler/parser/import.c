@@ -0,0 +1,117 @@
+/*
+ * Resolves names from imported interfaces.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <stdio.h>
+#include "intern.h"
+#include "log.h"
+#include "parser/import.h"
+
+static bool string_name(const interface_t* interface, uint32_t offset, uint32_t length, name_t* name)
+{
+        const char* string;
+        symbol_t symbol;
+
+        /* Ranges were checked when the interface was loaded */
+        string = interface_string(interface, offset);
+        symbol = intern(string, length, hash_data(string, length));
+        if (symbol == SYMBOL_NONE) {
+                return false;
+        }
+
+        symbol_name(symbol, name);
+        return true;
+}
+
+static node_id_t resolve_type(parser_t* parser, const interface_t* interface, uint32_t offset, uint32_t length)
+{
+        ast_node_t* type;
+        name_t name;
+
+        if (length == 0 || !string_name(interface, offset, length, &name)) {
+                return NODE_NONE;
+        }
+
+        type = scope_find(parser->type_scope, &name);
+        if (type == NULL) {
+                type = import_type(parser, &name);
+        }
+
+        if (type == NULL) {
+                fprintf(log_stderr(), "Imported type \"%.*s\" does not exist\n", (int)name.length, name.string);
+                return NODE_NONE;
+        }
+
+        return type->id;
+}
+
+/*
+ * Creates the AST nodes for one imported symbol. The node goes into its
+ * scope before its members are resolved, so it can refer to itself.
+ */
+static ast_node_t* materialize(parser_t* parser, const interface_t* interface, const interface_symbol_t* symbol, scope_t* scope)
+{
+        const interface_member_t* member;
+        ast_node_t* node;
+        ast_node_t* child;
+
+        node = create_node(&parser->ast, NULL);
+        if (node == NULL || !string_name(interface, symbol->name, symbol->name_length, &node->name)) {
+                return NULL;
+        }
+
+        node->kind = symbol->kind;
+        node->flags = NF_NAMED | NF_IMPORTED | (symbol->flags & NF_PUBLIC);
+        node->bytes = symbol->bytes;
+        node->ptr_depth = symbol->ptr_depth;
+        node->local_size = 0;
+        scope_add(scope, node);
+
+        node->type = resolve_type(parser, interface, symbol->type_name, symbol->type_length);
+        for (uint32_t i = 0; i < symbol->n_members; i++) {
+                member = &interface->members[symbol->first_member + i];
+
+                child = create_node(&parser->ast, node);
+                if (child == NULL || !string_name(interface, member->name, member->name_length, &child->name)) {
+                        break;
+                }
+
+                child->kind = node->kind == NK_STRUCT ? NK_STRUCT_MEMBER : NK_PARAMETER;
+                child->flags = NF_NAMED | NF_IMPORTED;
+                child->bytes = member->bytes;
+                child->ptr_depth = member->ptr_depth;
+                child->type = resolve_type(parser, interface, member->type_name, member->type_length);
+                push_node(&parser->ast, child, NULL);
+        }
+
+        /* May be in the middle of a declaration that later fails */
+        parser->ast.pinned = parser->ast.n_nodes - 1;
+        return node;
+}
+
+static ast_node_t* import_symbol(parser_t* parser, name_t* name, bool type, scope_t* scope)
+{
+        const interface_symbol_t* symbol;
+
+        for (size_t i = 0; i < parser->n_imports; i++) {
+                symbol = interface_find(&parser->imports[i], name->string, name->length, type);
+                if (symbol != NULL) {
+                        debug("Importing symbol...");
+                        return materialize(parser, &parser->imports[i], symbol, scope);
+                }
+        }
+
+        return NULL;
+}
+
+ast_node_t* import_type(parser_t* parser, name_t* name)
+{
+        return import_symbol(parser, name, true, parser->type_scope);
+}
+
+ast_node_t* import_procedure(parser_t* parser, name_t* name)
+{
+        return import_symbol(parser, name, false, parser->proc_scope);
+}
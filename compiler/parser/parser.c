@@ -6,9 +6,9 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
-#include "lexer.h"
 #include "log.h"
 #include "parser.h"
+#include "trace.h"
 #include "parser/type.h"
 #include "parser/procedure.h"
 
@@ -16,46 +16,150 @@ void parser_destory(parser_t* parser)
 {
         debug("Destroying parser...");
 
+        /* All nodes live in the arena, so there is no tree to walk */
         if (parser != NULL) {
-                delete_nodes(parser->procedures);
-                delete_nodes(parser->types);
+                ast_destroy(&parser->ast);
+                arena_destroy(&parser->arena);
+                arena_destroy(&parser->local_arena);
+                tokens_destroy(&parser->tokens);
         }
 }
 
-void parser_parse(parser_t* parser)
+static void end_declaration(trace_span_t* span, ast_node_t* node)
 {
+        /* Declarations that failed to parse may not have a name yet */
+        if (node == NULL) {
+                trace_end(span, "parse", "(error)", 7);
+                return;
+        }
+
+        trace_end(span, "parse", node->name.string, node->name.length);
+}
+
+bool parser_parse(parser_t* parser)
+{
+        bool status;
+
         debug("Parsing...");
 
-        next_token(parser);
-        while (parser->token.kind != TK_EOF) {
+        status = true;
+        parser->cursor = 0;
+        while (token_kind(parser) != TK_EOF) {
+                trace_span_t span;
                 ast_node_t* node;
                 bool public = false;
 
-                if (parser->token.kind == TK_PUB) {
+                /* Declarations always start in the global scope, and never look back at earlier ones */
+                parser->scope = parser->proc_scope;
+                tokens_drop(&parser->tokens, parser->cursor);
+
+                if (token_kind(parser) == TK_PUB) {
                         public = true;
                         next_token(parser);
                 }
 
-                if (parser->token.kind == TK_PROC) {
+                if (token_kind(parser) == TK_PROC) {
+                        trace_begin(&span);
                         node = parse_proc_declaration(parser);
-                } else if (parser->token.kind == TK_TYPE) {
+                        end_declaration(&span, node);
+                } else if (token_kind(parser) == TK_TYPE) {
+                        trace_begin(&span);
                         node = parse_type_declaration(parser);
+                        end_declaration(&span, node);
+                } else if (parser->tokens.source != NULL) {
+                        parser_error(parser, "Unexpected \"%.*s\"\n", (int)parser->tokens.lengths[token_index(&parser->tokens, parser->cursor)], token_pos(&parser->tokens, parser->cursor));
+                        return false;
+                } else if (token_kind(parser) == TK_IDENTIFIER) {
+                        name_t name;
+
+                        /* Streamed sources are gone by now, but names are interned */
+                        token_name(&parser->tokens, parser->cursor, &name);
+                        parser_error(parser, "Unexpected \"%.*s\"\n", (int)name.length, name.string);
+                        return false;
                 } else {
-                        error(&parser->token, "Unexpected \"%.*s\"\n", parser->token.length, parser->token.pos);
-                        break;
+                        parser_error(parser, "Unexpected token\n");
+                        return false;
                 }
 
-                if (public && node != NULL) {
+                if (node == NULL) {
+                        status = false;
+                } else if (public) {
                         node->flags |= NF_PUBLIC;
                 }
         }
+
+        return status;
+}
+
+static void init_state(parser_t* parser)
+{
+        parser->cursor = 0;
+
+        arena_init(&parser->arena);
+        ast_init(&parser->ast, &parser->arena);
+
+        arena_init(&parser->local_arena);
+
+        parser->type_scope = create_scope(&parser->arena, NULL, GLOBAL_SCOPE_SIZE);
+        parser->proc_scope = create_scope(&parser->arena, NULL, GLOBAL_SCOPE_SIZE);
+        parser->scope = parser->proc_scope;
+        parser->imports = NULL;
+        parser->n_imports = 0;
+        parser->on_definition = NULL;
+        parser->definition_context = NULL;
+
+        parser->types = init_types(&parser->ast, parser->type_scope);
+        parser->procedures = create_node(&parser->ast, NULL);
 }
 
-void parser_init(parser_t *parser, char* source)
+bool parser_init_piped(parser_t* parser, const char* filename, char* source)
 {
         debug("Initializing parser...");
 
-        lexer_init(&parser->lexer, source);
-        parser->types = init_types();
-        parser->procedures = create_node(NULL);
+        /* Tokens keep coming while the parser works */
+        if (!tokens_lex_piped(&parser->tokens, filename, source)) {
+                return false;
+        }
+
+        init_state(parser);
+        return true;
+}
+
+bool parser_init_lazy(parser_t* parser, const char* filename, char* source)
+{
+        debug("Initializing parser...");
+
+        /* Tokens are lexed as the parser gets to them, and dropped after their declaration */
+        if (!tokens_lex_lazy(&parser->tokens, filename, source)) {
+                return false;
+        }
+
+        init_state(parser);
+        return true;
+}
+
+bool parser_init_stream(parser_t* parser, const char* filename, int fd, window_handler_t on_window, void* context)
+{
+        debug("Initializing parser...");
+
+        /* Names are interned as they are lexed, so the source can be dropped */
+        if (!tokens_lex_stream(&parser->tokens, filename, fd, on_window, context)) {
+                return false;
+        }
+
+        init_state(parser);
+        return true;
+}
+
+bool parser_init(parser_t *parser, const char* filename, char* source, size_t size, size_t n_threads)
+{
+        debug("Initializing parser...");
+
+        /* Lex everything up front so the parser can look ahead freely */
+        if (!tokens_lex(&parser->tokens, filename, source, size, n_threads)) {
+                return false;
+        }
+
+        init_state(parser);
+        return true;
 }
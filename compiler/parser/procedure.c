@@ -6,6 +6,7 @@
 
 #include "log.h"
 #include "parser.h"
+#include "parser/import.h"
 #include "parser/procedure.h"
 #include "parser/statement.h"
 #include "parser/variable.h"
@@ -16,23 +17,22 @@ static bool parse_parameters(parser_t* parser, ast_node_t* parent)
 {
         debug("Parsing parameters...");
 
-        while (parser->token.kind != TK_RPAREN) {
+        while (token_kind(parser) != TK_RPAREN) {
                 ast_node_t* parameter;
 
-                parameter = parse_variable_declaration(parser, parent, NULL);
+                parameter = parse_variable_declaration(parser, parent);
                 if (parameter == NULL) {
                         return false;
                 }
 
                 /* Push parameter to parameter list */
                 parameter->kind = NK_PARAMETER;
-
-                /* TODO: Use &parent->params instead of NULL */
-                push_node(parameter, NULL);
+                push_node(&parser->ast, parameter, NULL);
+                scope_add(parser->scope, parameter);
 
                 /* Parameters are seperated by "," */
-                if (parser->token.kind != TK_COMMA && parser->token.kind != TK_RPAREN) {
-                        error(&parser->token, "Expected \",\" or \")\" after parameter definition\n");
+                if (token_kind(parser) != TK_COMMA && token_kind(parser) != TK_RPAREN) {
+                        parser_error(parser, "Expected \",\" or \")\" after parameter definition\n");
                         return false;
                 }
         }
@@ -41,35 +41,33 @@ static bool parse_parameters(parser_t* parser, ast_node_t* parent)
         return true;
 }
 
-ast_node_t* parse_proc_declaration(parser_t* parser)
+static ast_node_t* parse_procedure(parser_t* parser)
 {
         ast_node_t* procedure;
+        node_id_t body;
 
-        debug("Parsing procedure declaration...");
-
-        if (next_token(parser)->kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected procedure name after \"proc\"\n");
+        if (next_token(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected procedure name after \"proc\"\n");
                 return NULL;
         }
 
         /* Create procedure and set name */
-        procedure = create_node(parser->procedures);
+        procedure = create_node(&parser->ast, parser->procedures);
         procedure->kind = NK_PROCEDURE;
         procedure->flags = NF_NAMED;
-        procedure->name.string = parser->token.pos;
-        procedure->name.length = parser->token.length;
-        procedure->name.hash = parser->token.hash;
+        token_name(&parser->tokens, parser->cursor, &procedure->name);
+        procedure->local_size = 0;
 
-        if (next_token(parser)->kind != TK_LPAREN) {
-                error(&parser->token, "Expected \"(\" after procedure name\n");
-                delete_nodes(procedure);
+        if (next_token(parser) != TK_LPAREN) {
+                parser_error(parser, "Expected \"(\" after procedure name\n");
+                delete_nodes(&parser->ast, procedure);
                 return NULL;
         }
 
         /* Parse parameters, if any */
-        if (next_token(parser)->kind != TK_RPAREN) {
+        if (next_token(parser) != TK_RPAREN) {
                 if (!parse_parameters(parser, procedure)) {
-                        delete_nodes(procedure);
+                        delete_nodes(&parser->ast, procedure);
                         return NULL;
                 }
         } else {
@@ -77,74 +75,117 @@ ast_node_t* parse_proc_declaration(parser_t* parser)
         }
 
         /* Parse return type, if any */
-        if (parser->token.kind == TK_ARROW) {
+        if (token_kind(parser) == TK_ARROW) {
                 next_token(parser);
-                if (parse_type_reference(parser, procedure, NULL) == NULL) {
-                        delete_nodes(procedure);
+                if (parse_type_reference(parser, procedure) == NULL) {
+                        delete_nodes(&parser->ast, procedure);
                         return NULL;
                 }
         }
 
         /* Procedure declarations are terminated with a ";" */
-        if (parser->token.kind == TK_SEMICOLON) {
-                push_node(procedure, NULL);
+        if (token_kind(parser) == TK_SEMICOLON) {
+                push_node(&parser->ast, procedure, NULL);
+                scope_add(parser->proc_scope, procedure);
                 next_token(parser);
                 return procedure;
         }
 
         /* Procedure body must start with a "{" */
-        if (parser->token.kind != TK_LCURLY) {
-                error(&parser->token, "Expected \";\" or \"{\" after \")\"\n");
-                delete_nodes(procedure);
+        if (token_kind(parser) != TK_LCURLY) {
+                parser_error(parser, "Expected \";\" or \"{\" after \")\"\n");
+                delete_nodes(&parser->ast, procedure);
                 return NULL;
         }
 
         /* Parse body, if any */
-        if (next_token(parser)->kind != TK_RCURLY) {
+        body = parser->ast.n_nodes;
+        if (next_token(parser) != TK_RCURLY) {
                 procedure->flags |= NF_DEFINITION;
                 if (!parse_statement_group(parser, procedure, procedure)) {
-                        delete_nodes(procedure);
+                        delete_nodes(&parser->ast, procedure);
                         return NULL;
                 }
         } else {
                 next_token(parser);
         }
 
-        push_node(procedure, NULL);
+        push_node(&parser->ast, procedure, NULL);
+        scope_add(parser->proc_scope, procedure);
+
+        /* Calls only need the signature once the body has been handled */
+        if (parser->on_definition != NULL && (procedure->flags & NF_DEFINITION)) {
+                parser->on_definition(parser->definition_context, &parser->ast, procedure, body);
+                release_nodes(&parser->ast, procedure, body);
+        }
+
         return procedure;
 }
 
-ast_node_t* parse_proc_call(parser_t* parser, ast_node_t* parent, token_t* callee_name)
+ast_node_t* parse_proc_declaration(parser_t* parser)
 {
+        ast_node_t* procedure;
+        scope_t* scope;
+
+        debug("Parsing procedure declaration...");
+
+        /* Parameters and locals go in the procedure's own scope */
+        scope = create_scope(&parser->local_arena, parser->proc_scope, LOCAL_SCOPE_SIZE);
+        if (scope == NULL) {
+                return NULL;
+        }
+
+        parser->scope = scope;
+        procedure = parse_procedure(parser);
+
+        /* Nothing looks a local up once its procedure is parsed, so the next one reuses the memory */
+        parser->scope = parser->proc_scope;
+        arena_rewind(&parser->local_arena, scope);
+
+        return procedure;
+}
+
+ast_node_t* parse_proc_call(parser_t* parser, ast_node_t* parent)
+{
+        token_id_t callee_token;
+        name_t callee_name;
         ast_node_t* callee;
         ast_node_t* call;
 
         debug("Parsing procedure call...");
 
-        callee = find_node(callee_name, parent);
+        callee_token = parser->cursor;
+        token_name(&parser->tokens, callee_token, &callee_name);
+        callee = scope_find(parser->scope, &callee_name);
+        if (callee == NULL) {
+                callee = import_procedure(parser, &callee_name);
+        }
+
         if (callee == NULL) {
-                error(callee_name, "\"%.*s\" does not exist\n", callee_name->length, callee_name->pos);
+                error(&parser->tokens, callee_token, "\"%.*s\" does not exist\n", (int)callee_name.length, callee_name.string);
                 return NULL;
         }
 
         /* Create call */
-        call = create_node(parent);
+        call = create_node(&parser->ast, parent);
         call->kind = NK_CALL;
-        call->callee = callee;
+        call->callee = callee->id;
 
+        /* Skip the name and "(" */
+        next_token(parser);
         next_token(parser);
-        while (parser->token.kind != TK_RPAREN) {
+        while (token_kind(parser) != TK_RPAREN) {
                 if (parse_value(parser, call) == NULL) {
-                        delete_nodes(call);
+                        delete_nodes(&parser->ast, call);
                         return NULL;
                 }
 
-                if (parser->token.kind == TK_COMMA && next_token(parser)->kind == TK_RPAREN) {
-                        warn(&parser->token, "Extra \",\" after arguments\n");
+                if (token_kind(parser) == TK_COMMA && next_token(parser) == TK_RPAREN) {
+                        parser_warn(parser, "Extra \",\" after arguments\n");
                 }
         }
 
-        push_node(call, NULL);
+        push_node(&parser->ast, call, NULL);
         next_token(parser);
         return call;
 }
@@ -0,0 +1,129 @@
+/*
+ * Scoped symbol tables.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <string.h>
+#include "counters.h"
+#include "log.h"
+#include "parser/scope.h"
+
+static inline uint32_t slot_index(symbol_t symbol, uint32_t mask)
+{
+        /* Symbols are dense, spread neighbours apart */
+        return (symbol * 0x9e3779b1u) & mask;
+}
+
+static scope_slot_t* alloc_slots(arena_t* arena, uint32_t capacity)
+{
+        scope_slot_t* slots;
+
+        slots = arena_alloc(arena, capacity * sizeof(scope_slot_t));
+        if (slots != NULL) {
+                memset(slots, 0, capacity * sizeof(scope_slot_t));
+        }
+
+        return slots;
+}
+
+static void insert_slot(scope_t* scope, symbol_t symbol, ast_node_t* node)
+{
+        uint32_t mask, i;
+
+        mask = scope->capacity - 1;
+        for (i = slot_index(symbol, mask); scope->slots[i].symbol != SYMBOL_NONE; i = (i + 1) & mask);
+        scope->slots[i].symbol = symbol;
+        scope->slots[i].node = node;
+}
+
+static bool grow(scope_t* scope)
+{
+        scope_slot_t* old_slots;
+        uint32_t old_capacity;
+
+        old_slots = scope->slots;
+        old_capacity = scope->capacity;
+
+        scope->slots = alloc_slots(scope->arena, old_capacity * 2);
+        if (scope->slots == NULL) {
+                scope->slots = old_slots;
+                return false;
+        }
+        scope->capacity = old_capacity * 2;
+
+        /* Old slots stay in the arena until it is rewound or destroyed */
+        for (uint32_t i = 0; i < old_capacity; i++) {
+                if (old_slots[i].symbol != SYMBOL_NONE) {
+                        insert_slot(scope, old_slots[i].symbol, old_slots[i].node);
+                }
+        }
+
+        return true;
+}
+
+ast_node_t* scope_find(scope_t* scope, name_t* name)
+{
+        uint32_t mask, i;
+
+        /* Search this scope, then every enclosing scope */
+        counters.scope_lookups++;
+        while (scope != NULL) {
+                mask = scope->capacity - 1;
+                for (i = slot_index(name->symbol, mask); scope->slots[i].symbol != SYMBOL_NONE; i = (i + 1) & mask) {
+                        counters.scope_probes++;
+                        if (scope->slots[i].symbol == name->symbol) {
+                                return scope->slots[i].node;
+                        }
+                }
+
+                scope = scope->parent;
+                if (scope != NULL) {
+                        counters.scope_walks++;
+                }
+        }
+
+        /* Symbol not found */
+        return NULL;
+}
+
+bool scope_add(scope_t* scope, ast_node_t* node)
+{
+        if (node->name.symbol == SYMBOL_NONE) {
+                return false;
+        }
+
+        /* Keep the load factor under 3/4 */
+        if ((scope->count + 1) * 4 > scope->capacity * 3 && !grow(scope)) {
+                return false;
+        }
+
+        insert_slot(scope, node->name.symbol, node);
+        scope->count++;
+        return true;
+}
+
+scope_t* create_scope(arena_t* arena, scope_t* parent, size_t size)
+{
+        scope_t* scope;
+        uint32_t capacity;
+
+        scope = arena_alloc(arena, sizeof(scope_t));
+        if (scope == NULL) {
+                return NULL;
+        }
+
+        /* Round up to a power of two so probing can mask */
+        for (capacity = 1; capacity < size; capacity <<= 1);
+
+        scope->parent = parent;
+        scope->arena = arena;
+        scope->capacity = capacity;
+        scope->count = 0;
+        scope->slots = alloc_slots(arena, capacity);
+        if (scope->slots == NULL) {
+                return NULL;
+        }
+
+        return scope;
+}
@@ -4,7 +4,6 @@
  * Provided under the BSD 3-Clause license.
  */
 
-#include <string.h>
 #include "log.h"
 #include "parser/value.h"
 #include "parser/statement.h"
@@ -17,41 +16,41 @@ static ast_node_t* parse_return(parser_t* parser, ast_node_t* parent, ast_node_t
 
         debug("Parsing return...");
 
-        statement = create_node(parent);
+        statement = create_node(&parser->ast, parent);
         statement->kind = NK_RETURN;
         statement->type = procedure->type;
 
         /* Allow returns with no value */
-        if (next_token(parser)->kind == TK_SEMICOLON) {
-                if (procedure->type != NULL) {
-                        error(&parser->token, "Procedure \"%.*s\" must return a value\n", procedure->name.length, procedure->name.string);
-                        delete_nodes(statement);
+        if (next_token(parser) == TK_SEMICOLON) {
+                if (procedure->type != NODE_NONE) {
+                        parser_error(parser, "Procedure \"%.*s\" must return a value\n", procedure->name.length, procedure->name.string);
+                        delete_nodes(&parser->ast, statement);
                         return NULL;
                 }
 
-                push_node(statement, NULL);
+                push_node(&parser->ast, statement, NULL);
                 return statement;
         }
 
-        if (procedure->type == NULL) {
-                error(&parser->token, "Procedure \"%.*s\" does not have a return type\n", procedure->name.length, procedure->name.string);
-                delete_nodes(statement);
+        if (procedure->type == NODE_NONE) {
+                parser_error(parser, "Procedure \"%.*s\" does not have a return type\n", procedure->name.length, procedure->name.string);
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
         /* Parse return value */
         if (parse_value(parser, statement) == NULL) {
-                delete_nodes(statement);
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
-        if (parser->token.kind != TK_SEMICOLON) {
-                error(&parser->token, "Expected \";\" after return statement\n");
-                delete_nodes(statement);
+        if (token_kind(parser) != TK_SEMICOLON) {
+                parser_error(parser, "Expected \";\" after return statement\n");
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
-        push_node(statement, NULL);
+        push_node(&parser->ast, statement, NULL);
         next_token(parser);
         return statement;
 }
@@ -63,87 +62,89 @@ static ast_node_t* parse_if(parser_t* parser, ast_node_t* parent, ast_node_t* pr
 
         debug("Parsing if...");
 
-        if (next_token(parser)->kind != TK_LPAREN) {
-                error(&parser->token, "Expected \"(\" after \"if\"\n");
+        if (next_token(parser) != TK_LPAREN) {
+                parser_error(parser, "Expected \"(\" after \"if\"\n");
                 return NULL;
         }
 
-        if (next_token(parser)->kind == TK_RPAREN) {
-                error(&parser->token, "Expected conditions after \"(\"\n");
+        if (next_token(parser) == TK_RPAREN) {
+                parser_error(parser, "Expected conditions after \"(\"\n");
                 return NULL;
         }
 
-        statement = create_node(parent);
+        statement = create_node(&parser->ast, parent);
         statement->kind = NK_IF;
 
-        conditions = create_node(statement);
+        conditions = create_node(&parser->ast, statement);
         conditions->kind = NK_CONDITIONS;
-        push_node(conditions, NULL);
+        push_node(&parser->ast, conditions, NULL);
 
         if (!parse_value(parser, conditions)) {
-                delete_nodes(statement);
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
-        if (parser->token.kind != TK_RPAREN) {
-                error(&parser->token, "Expected \")\" after conditions\n");
-                delete_nodes(statement);
+        if (token_kind(parser) != TK_RPAREN) {
+                parser_error(parser, "Expected \")\" after conditions\n");
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
         /* If body must start with a "{" */
-        if (next_token(parser)->kind != TK_LCURLY) {
-                error(&parser->token, "Expected \"{\" after \")\"\n");
-                delete_nodes(statement);
+        if (next_token(parser) != TK_LCURLY) {
+                parser_error(parser, "Expected \"{\" after \")\"\n");
+                delete_nodes(&parser->ast, statement);
                 return NULL;
         }
 
         /* Parse body, if any */
-        if (next_token(parser)->kind != TK_RCURLY) {
-                if (!parse_statement_group(parser, statement, procedure)) {
-                        delete_nodes(statement);
+        if (next_token(parser) != TK_RCURLY) {
+                bool status;
+
+                /* Locals declared in the body are only visible inside it */
+                parser->scope = create_scope(&parser->local_arena, parser->scope, LOCAL_SCOPE_SIZE);
+                status = parse_statement_group(parser, statement, procedure);
+                parser->scope = parser->scope->parent;
+
+                if (!status) {
+                        delete_nodes(&parser->ast, statement);
                         return NULL;
                 }
         } else {
                 next_token(parser);
         }
 
-        push_node(statement, NULL);
+        push_node(&parser->ast, statement, NULL);
         return statement;
 }
 
 ast_node_t* parse_statement(parser_t* parser, ast_node_t* parent, ast_node_t* procedure)
 {
-        token_t name;
-
         debug("Parsing statement...");
 
-        if (parser->token.kind == TK_RETURN) {
+        if (token_kind(parser) == TK_RETURN) {
                 return parse_return(parser, parent, procedure);
-        } else if (parser->token.kind == TK_IF) {
+        } else if (token_kind(parser) == TK_IF) {
                 return parse_if(parser, parent, procedure);
         }
 
-        if (parser->token.kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected statement\n");
+        if (token_kind(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected statement\n");
                 return NULL;
                 
         }
 
-        memcpy(&name, &parser->token, sizeof(token_t));
-        next_token(parser);
-
         /* TODO: Structs will eventually have methods like console.print() */
-        if (parser->token.kind == TK_LPAREN) {
+        if (peek_token(parser, 1) == TK_LPAREN) {
                 ast_node_t* call;
 
-                call = parse_proc_call(parser, parent, &name);
+                call = parse_proc_call(parser, parent);
                 if (call == NULL) {
                         return NULL;
                 }
 
-                if (parser->token.kind != TK_SEMICOLON) {
-                        error(&parser->token, "Expected \";\" after \")\"\n");
+                if (token_kind(parser) != TK_SEMICOLON) {
+                        parser_error(parser, "Expected \";\" after \")\"\n");
                         return NULL;
                 }
 
@@ -151,14 +152,14 @@ ast_node_t* parse_statement(parser_t* parser, ast_node_t* parent, ast_node_t* pr
                 return call;
         }
 
-        return parse_local_declaration(parser, parent, procedure, &name);
+        return parse_local_declaration(parser, parent, procedure);
 }
 
 bool parse_statement_group(parser_t* parser, ast_node_t* parent, ast_node_t* procedure)
 {
         debug("Parsing statement group...");
 
-        while (parser->token.kind != TK_RCURLY) {
+        while (token_kind(parser) != TK_RCURLY) {
                 ast_node_t* statement;
 
                 statement = parse_statement(parser, parent, procedure);
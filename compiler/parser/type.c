@@ -7,23 +7,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hash.h"
+#include "intern.h"
 #include "log.h"
+#include "parser/import.h"
 #include "parser/type.h"
 #include "parser/variable.h"
 
-static void create_builtin_type(ast_node_t* types, char* name, size_t bytes, uint8_t flags)
+typedef struct {
+        char* name;
+        uint32_t bytes;
+        symbol_t symbol;
+} builtin_type_t;
+
+/* Names are interned once by types_init(), before any file is parsed */
+static builtin_type_t builtin_types[] = {
+        { "any", 0, SYMBOL_NONE },
+        { "uint8", 1, SYMBOL_NONE },
+        { "uint16", 2, SYMBOL_NONE },
+        { "uint32", 4, SYMBOL_NONE },
+        { "uint64", 8, SYMBOL_NONE },
+        { "uint", sizeof(void*), SYMBOL_NONE },
+        { "char", 1, SYMBOL_NONE }
+};
+
+static void create_builtin_type(ast_t* ast, scope_t* scope, ast_node_t* types, builtin_type_t* builtin)
 {
         ast_node_t* type;
 
-        type = create_node(types);
+        type = create_node(ast, types);
         type->kind = NK_BUILTIN_TYPE;
-        type->flags |= flags | NF_NAMED;
-        type->name.string = name;
-        type->name.length = strlen(name);
-        type->name.hash = hash_data(name, type->name.length);
-        type->bytes = bytes;
+        type->flags |= NF_NAMED;
+        symbol_name(builtin->symbol, &type->name);
+        type->bytes = builtin->bytes;
+        type->ptr_depth = 0;
 
-        push_node(type, NULL);
+        push_node(ast, type, NULL);
+        scope_add(scope, type);
 }
 
 static bool parse_struct_members(parser_t* parser, ast_node_t* type)
@@ -31,22 +50,23 @@ static bool parse_struct_members(parser_t* parser, ast_node_t* type)
         debug("Parsing struct members...");
 
         type->bytes = 0;
-        while (parser->token.kind != TK_RCURLY) {
+        while (token_kind(parser) != TK_RCURLY) {
                 ast_node_t* member;
 
-                member = parse_variable_declaration(parser, type, NULL);
+                member = parse_variable_declaration(parser, type);
                 if (member == NULL) {
                         return false;
                 }
 
-                if (parser->token.kind != TK_SEMICOLON) {
-                        error(&parser->token, "Expected \";\"\n");
-                        delete_nodes(member);
+                if (token_kind(parser) != TK_SEMICOLON) {
+                        parser_error(parser, "Expected \";\"\n");
+                        delete_nodes(&parser->ast, member);
                         return false;
                 }
 
                 member->kind = NK_STRUCT_MEMBER;
-                push_node(member, NULL);
+                push_node(&parser->ast, member, NULL);
+                scope_add(parser->scope, member);
                 next_token(parser);
 
                 type->bytes += member->bytes;
@@ -58,27 +78,42 @@ static bool parse_struct_members(parser_t* parser, ast_node_t* type)
 
 static ast_node_t* parse_struct_declaration(parser_t* parser, ast_node_t* type)
 {
+        scope_t* scope;
+        bool status;
+
         type->kind = NK_STRUCT;
 
         debug("Parsing struct declaration...");
 
-        if (next_token(parser)->kind != TK_LCURLY) {
-                error(&parser->token, "Expected \"{\" after \"struct\"\n");
-                delete_nodes(type);
+        if (next_token(parser) != TK_LCURLY) {
+                parser_error(parser, "Expected \"{\" after \"struct\"\n");
+                delete_nodes(&parser->ast, type);
                 return NULL;
         }
 
-        /* Parse struct members */
-        if (next_token(parser)->kind != TK_RCURLY) {
-                if (!parse_struct_members(parser, type)) {
-                        delete_nodes(type);
+        /* Parse struct members, their names are only kept while they are parsed */
+        if (next_token(parser) != TK_RCURLY) {
+                scope = create_scope(&parser->local_arena, parser->type_scope, LOCAL_SCOPE_SIZE);
+                if (scope == NULL) {
+                        delete_nodes(&parser->ast, type);
+                        return NULL;
+                }
+
+                parser->scope = scope;
+                status = parse_struct_members(parser, type);
+                parser->scope = parser->proc_scope;
+                arena_rewind(&parser->local_arena, scope);
+
+                if (!status) {
+                        delete_nodes(&parser->ast, type);
                         return NULL;
                 }
         } else {
                 next_token(parser);
         }
 
-        push_node(type, NULL);
+        push_node(&parser->ast, type, NULL);
+        scope_add(parser->type_scope, type);
         return type;
 }
 
@@ -88,92 +123,91 @@ ast_node_t* parse_type_declaration(parser_t* parser)
 
         debug("Parsing type declaration...");
 
-        if (next_token(parser)->kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected type name after \"type\"\n");
+        if (next_token(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected type name after \"type\"\n");
                 return NULL;
         }
 
         /* Create type and set name */
-        type = create_node(parser->types);
+        type = create_node(&parser->ast, parser->types);
         type->flags = NF_NAMED;
-        type->name.string = parser->token.pos;
-        type->name.length = parser->token.length;
-        type->name.hash = parser->token.hash;
+        token_name(&parser->tokens, parser->cursor, &type->name);
 
-        if (next_token(parser)->kind != TK_COLON) {
-                error(&parser->token, "Expected \":\" after type name\n");
-                delete_nodes(type);
+        if (next_token(parser) != TK_COLON) {
+                parser_error(parser, "Expected \":\" after type name\n");
+                delete_nodes(&parser->ast, type);
                 return NULL;
         }
 
-        if (next_token(parser)->kind == TK_STRUCT) {
+        if (next_token(parser) == TK_STRUCT) {
                 return parse_struct_declaration(parser, type);
         }
 
         /* TODO: Implement enums */
-        if (parser->token.kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected \"struct\" or type name after \":\"\n");
-                delete_nodes(type);
+        if (token_kind(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected \"struct\" or type name after \":\"\n");
+                delete_nodes(&parser->ast, type);
                 return NULL;
         }
 
         /* Parse aliased type */
-        if (parse_type_reference(parser, type, NULL) == NULL) {
-                delete_nodes(type);
+        if (parse_type_reference(parser, type) == NULL) {
+                delete_nodes(&parser->ast, type);
                 return NULL;
         }
 
         /* Type aliases must be terminated with a ";" */
-        if (parser->token.kind != TK_SEMICOLON) {
-                error(&parser->token, "Expected \";\" after type reference\n");
-                delete_nodes(type);
+        if (token_kind(parser) != TK_SEMICOLON) {
+                parser_error(parser, "Expected \";\" after type reference\n");
+                delete_nodes(&parser->ast, type);
                 return NULL;
         }
 
         /* Set alias properties */
         type->kind = NK_TYPE_ALIAS;
-        type->bytes = type->type->bytes;
+        type->bytes = get_node(&parser->ast, type->type)->bytes;
 
-        push_node(type, NULL);
+        push_node(&parser->ast, type, NULL);
+        scope_add(parser->type_scope, type);
         next_token(parser);
         return type;
 }
 
-ast_node_t* parse_type_reference(parser_t* parser, ast_node_t* node, token_t* type_name)
+ast_node_t* parse_type_reference(parser_t* parser, ast_node_t* node)
 {
+        token_id_t type_token;
+        name_t type_name;
         ast_node_t* type;
         size_t ptr_depth;
 
-        if (parser->token.kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected type name\n");
+        if (token_kind(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected type name\n");
                 return NULL;
         }
 
-        /* Use current token if no type name was specified */
-        if (type_name == NULL) {
-                type_name = &parser->token;
+        /* Find type */
+        type_token = parser->cursor;
+        token_name(&parser->tokens, type_token, &type_name);
+        type = scope_find(parser->type_scope, &type_name);
+        if (type == NULL) {
+                type = import_type(parser, &type_name);
         }
 
-        /* Find type */
-        type = find_node(type_name, parser->types);
         if (type == NULL) {
-                error(type_name, "\"%.*s\" does not exist or is not a type\n", type_name->length, type_name->pos);
+                parser_error(parser, "\"%.*s\" does not exist or is not a type\n", (int)type_name.length, type_name.string);
                 return NULL;
         }
 
-        /* Advance if the current token was used as the type name */
-        if (type_name == &parser->token) {
-                next_token(parser);
-        }
+        next_token(parser);
 
         /* Find pointer depth */
         ptr_depth = 0;
-        while (parser->token.kind == TK_STAR) {
+        while (token_kind(parser) == TK_STAR) {
                 ptr_depth++;
                 next_token(parser);
         }
 
-        node->type = type;
+        node->type = type->id;
         node->ptr_depth = ptr_depth;
 
         if (node->ptr_depth > 0) {
@@ -181,30 +215,43 @@ ast_node_t* parse_type_reference(parser_t* parser, ast_node_t* node, token_t* ty
                 return type;
         }
 
-        if (node->type->bytes == 0) {
-                error(type_name, "\"%.*s\" can only be used as a pointer\n", node->type->name.length, node->type->name.string);
+        if (type->bytes == 0) {
+                error(&parser->tokens, type_token, "\"%.*s\" can only be used as a pointer\n", type->name.length, type->name.string);
                 return NULL;
         }
 
-        node->bytes = node->type->bytes;
+        node->bytes = type->bytes;
         return type;
 }
 
-ast_node_t* init_types(void)
+ast_node_t* init_types(ast_t* ast, scope_t* scope)
 {
         ast_node_t* types;
 
         debug("Initializing types...");
 
-        types = create_node(NULL);
+        types = create_node(ast, NULL);
 
-        create_builtin_type(types, "any", 0, NF_NONE);
-        create_builtin_type(types, "uint8", 1, NF_NONE);
-        create_builtin_type(types, "uint16", 2, NF_NONE);
-        create_builtin_type(types, "uint32", 4, NF_NONE);
-        create_builtin_type(types, "uint64", 8, NF_NONE);
-        create_builtin_type(types, "uint", sizeof(void*), NF_NONE);
-        create_builtin_type(types, "char", 1, NF_NONE);
+        for (size_t i = 0; i < sizeof(builtin_types) / sizeof(builtin_types[0]); i++) {
+                create_builtin_type(ast, scope, types, &builtin_types[i]);
+        }
 
         return types;
 }
+
+bool types_init(void)
+{
+        builtin_type_t* builtin;
+
+        debug("Interning builtin types...");
+
+        for (size_t i = 0; i < sizeof(builtin_types) / sizeof(builtin_types[0]); i++) {
+                builtin = &builtin_types[i];
+                builtin->symbol = intern(builtin->name, strlen(builtin->name), hash_string(builtin->name));
+                if (builtin->symbol == SYMBOL_NONE) {
+                        return false;
+                }
+        }
+
+        return true;
+}
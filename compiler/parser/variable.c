@@ -9,85 +9,88 @@
 #include "parser/value.h"
 #include "parser/variable.h"
 
-ast_node_t* parse_variable_declaration(parser_t* parser, ast_node_t* parent, token_t* type_name)
+ast_node_t* parse_variable_declaration(parser_t* parser, ast_node_t* parent)
 {
         ast_node_t* variable;
+        name_t name;
 
         debug("Parsing variable declartation...");
 
         /* Create variable and parse type */
-        variable = create_node(parent);
+        variable = create_node(&parser->ast, parent);
         variable->flags = NF_NAMED;
-        if (parse_type_reference(parser, variable, type_name) == NULL) {
-                delete_nodes(variable);
+        if (parse_type_reference(parser, variable) == NULL) {
+                delete_nodes(&parser->ast, variable);
                 return NULL;
         }
 
-        if (parser->token.kind != TK_IDENTIFIER) {
-                error(&parser->token, "Expected name after type\n");
-                delete_nodes(variable);
+        if (token_kind(parser) != TK_IDENTIFIER) {
+                parser_error(parser, "Expected name after type\n");
+                delete_nodes(&parser->ast, variable);
                 return NULL;
         }
 
         /* Prevent redeclaring a variable */
-        if (find_node(&parser->token, parent) != NULL) {
-                error(&parser->token, "\"%.*s\" has already been declared\n", parser->token.length, parser->token.pos);
-                delete_nodes(variable);
+        token_name(&parser->tokens, parser->cursor, &name);
+        if (scope_find(parser->scope, &name) != NULL) {
+                parser_error(parser, "\"%.*s\" has already been declared\n", (int)name.length, name.string);
+                delete_nodes(&parser->ast, variable);
                 return NULL;
         }
 
         /* Set variable name */
-        variable->name.string = parser->token.pos;
-        variable->name.length = parser->token.length;
-        variable->name.hash = parser->token.hash;
+        variable->name = name;
 
         next_token(parser);
         return variable;
 }
 
-ast_node_t* parse_variable_reference(ast_node_t* parent, token_t* variable_name)
+ast_node_t* parse_variable_reference(parser_t* parser, ast_node_t* parent)
 {
         ast_node_t* reference;
         ast_node_t* variable;
+        name_t name;
 
-        variable = find_node(variable_name, parent);
+        token_name(&parser->tokens, parser->cursor, &name);
+        variable = scope_find(parser->scope, &name);
         if (variable == NULL || (variable->kind != NK_LOCAL_VARIABLE && variable->kind != NK_PARAMETER)) {
-                error(variable_name, "\"%.*s\" does not exist or is not a variable\n", variable_name->length, variable_name->pos);
+                parser_error(parser, "\"%.*s\" does not exist or is not a variable\n", (int)name.length, name.string);
                 return NULL;
         }
 
         /* TODO: Struct and enum member references */
 
-        reference = create_node(parent);
+        reference = create_node(&parser->ast, parent);
         reference->kind = NK_VARIABLE_REFERENCE;
-        reference->variable = variable;
+        reference->variable = variable->id;
 
-        push_node(reference, NULL);
+        push_node(&parser->ast, reference, NULL);
+        next_token(parser);
         return reference;
 }
 
-ast_node_t* parse_local_declaration(parser_t* parser, ast_node_t* parent, ast_node_t* procedure, token_t* type_name)
+ast_node_t* parse_local_declaration(parser_t* parser, ast_node_t* parent, ast_node_t* procedure)
 {
         ast_node_t* variable;
 
         debug("Parsing local variable declaration...");
 
-        variable = parse_variable_declaration(parser, parent, type_name);
+        variable = parse_variable_declaration(parser, parent);
         if (variable == NULL) {
                 return NULL;
         }
 
-        if (parser->token.kind == TK_EQUALS) {
+        if (token_kind(parser) == TK_EQUALS) {
                 next_token(parser);
                 if (parse_value(parser, variable) == NULL) {
-                        delete_nodes(variable);
+                        delete_nodes(&parser->ast, variable);
                         return NULL;
                 }
         }
 
-        if (parser->token.kind != TK_SEMICOLON) {
-                error(&parser->token, "Expected \";\" after variable declaration\n");
-                delete_nodes(variable);
+        if (token_kind(parser) != TK_SEMICOLON) {
+                parser_error(parser, "Expected \";\" after variable declaration\n");
+                delete_nodes(&parser->ast, variable);
                 return NULL;
         }
 
@@ -95,7 +98,8 @@ ast_node_t* parse_local_declaration(parser_t* parser, ast_node_t* parent, ast_no
         variable->local_offset = procedure->local_size;
         procedure->local_size += variable->bytes;
 
-        push_node(variable, NULL);
+        push_node(&parser->ast, variable, NULL);
+        scope_add(parser->scope, variable);
         next_token(parser);
         return variable;
 }
@@ -0,0 +1,74 @@
+/*
+ * Simple worker pool.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "log.h"
+#include "pool.h"
+
+typedef struct {
+        pool_job_t job;
+        void* context;
+        size_t count;
+        atomic_size_t next;
+} pool_t;
+
+static void* worker(void* arg)
+{
+        pool_t* pool;
+        size_t i;
+
+        pool = arg;
+        while ((i = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+                pool->job(pool->context, i);
+        }
+
+        return NULL;
+}
+
+bool pool_run(size_t n_threads, size_t count, pool_job_t job, void* context)
+{
+        pthread_t* threads;
+        size_t n_started;
+        pool_t pool;
+
+        pool.job = job;
+        pool.context = context;
+        pool.count = count;
+        atomic_init(&pool.next, 0);
+
+        if (n_threads > count) {
+                n_threads = count;
+        }
+
+        /* The calling thread is one of the workers */
+        threads = NULL;
+        n_started = 0;
+        if (n_threads > 1) {
+                threads = malloc((n_threads - 1) * sizeof(pthread_t));
+                if (threads == NULL) {
+                        return false;
+                }
+
+                while (n_started < n_threads - 1) {
+                        if (pthread_create(&threads[n_started], NULL, worker, &pool) != 0) {
+                                break;
+                        }
+
+                        n_started++;
+                }
+        }
+
+        worker(&pool);
+
+        for (size_t i = 0; i < n_started; i++) {
+                pthread_join(threads[i], NULL);
+        }
+
+        free(threads);
+        return true;
+}
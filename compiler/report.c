@@ -0,0 +1,255 @@
+/*
+ * Per-phase timing and memory reports.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "log.h"
+#include "report.h"
+#include "trace.h"
+
+static const char* phase_names[PHASE_COUNT] = {
+        [PHASE_LOAD] = "load",
+        [PHASE_LEX] = "lex",
+        [PHASE_PARSE] = "parse",
+        [PHASE_CODEGEN] = "codegen",
+        [PHASE_OUTPUT] = "output"
+};
+
+static uint64_t read_clock(clockid_t id)
+{
+        struct timespec ts;
+
+        clock_gettime(id, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static double to_ms(uint64_t ns)
+{
+        return (double)ns / 1000000.0;
+}
+
+static long peak_rss(void)
+{
+        struct rusage usage;
+
+        /* In KiB on Linux */
+        if (getrusage(RUSAGE_SELF, &usage) < 0) {
+                return 0;
+        }
+
+        return usage.ru_maxrss;
+}
+
+void report_start(report_clock_t* clock)
+{
+        clock->wall = read_clock(CLOCK_MONOTONIC);
+        clock->cpu = read_clock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void report_phase(report_t* report, phase_t phase, report_clock_t* clock)
+{
+        report_clock_t now;
+
+        /* The next phase starts where this one ends */
+        report_start(&now);
+        report->wall[phase] += now.wall - clock->wall;
+        report->cpu[phase] += now.cpu - clock->cpu;
+        trace_add("phase", phase_names[phase], strlen(phase_names[phase]), clock->wall, now.wall);
+        *clock = now;
+}
+
+void report_count_source(report_t* report, const char* source, size_t size)
+{
+        const char* end;
+
+        report->source_bytes += size;
+        end = source + size;
+        while (source < end && (source = memchr(source, '\n', (size_t)(end - source))) != NULL) {
+                report->lines++;
+                source++;
+        }
+}
+
+void report_count_tokens(report_t* report, token_stream_t* tokens)
+{
+        size_t token_size;
+
+        token_size = sizeof(*tokens->kinds) + sizeof(*tokens->flags) + sizeof(*tokens->offsets) + sizeof(*tokens->lengths)
+                + sizeof(*tokens->values);
+        report->tokens += tokens->count;
+        report->token_bytes += tokens->capacity * token_size;
+}
+
+void report_count_nodes(report_t* report, ast_t* ast, node_id_t first)
+{
+        /* Released bodies are counted just before they go */
+        for (node_id_t id = first; id < ast->n_nodes; id++) {
+                report->nodes[get_node(ast, id)->kind]++;
+        }
+}
+
+void report_begin(report_t* report)
+{
+        memset(report, 0, sizeof(report_t));
+        memset(&counters, 0, sizeof(counters_t));
+        report->files = 1;
+}
+
+void report_end(report_summary_t* summary, report_t* report)
+{
+        uint64_t* dest;
+        uint64_t* src;
+
+        report->counters = counters;
+
+        /* Every field is a counter, so the report can be summed as an array */
+        pthread_mutex_lock(&summary->lock);
+        dest = (uint64_t*)&summary->total;
+        src = (uint64_t*)report;
+        for (size_t i = 0; i < sizeof(report_t) / sizeof(uint64_t); i++) {
+                dest[i] += src[i];
+        }
+        pthread_mutex_unlock(&summary->lock);
+}
+
+static void print_time(FILE* file, report_summary_t* summary)
+{
+        uint64_t run_wall, run_cpu, wall, cpu;
+        report_t* total;
+
+        total = &summary->total;
+        run_wall = read_clock(CLOCK_MONOTONIC) - summary->start.wall;
+        run_cpu = read_clock(CLOCK_PROCESS_CPUTIME_ID) - summary->start.cpu;
+
+        fprintf(file, "time report (%lu file(s)):\n", total->files);
+        fprintf(file, "  %-10s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+
+        wall = 0;
+        cpu = 0;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+                fprintf(file, "  %-10s %12.3f %12.3f\n", phase_names[i], to_ms(total->wall[i]), to_ms(total->cpu[i]));
+                wall += total->wall[i];
+                cpu += total->cpu[i];
+        }
+
+        fprintf(file, "  %-10s %12.3f %12.3f\n", "total", to_ms(wall), to_ms(cpu));
+        fprintf(file, "  %-10s %12.3f %12.3f\n", "run", to_ms(run_wall), to_ms(run_cpu));
+}
+
+static void print_memory(FILE* file, report_summary_t* summary)
+{
+        report_t* total;
+        counters_t* c;
+
+        total = &summary->total;
+        c = &total->counters;
+        fprintf(file, "memory report (%lu file(s)):\n", total->files);
+        fprintf(file, "  source: %lu byte(s), %lu line(s)\n", total->source_bytes, total->lines);
+        fprintf(file, "  tokens: %lu, %lu byte(s)\n", total->tokens, total->token_bytes);
+        fprintf(file, "  arenas: %lu byte(s) allocated, %lu byte(s) reserved\n", c->arena_bytes, c->arena_reserved);
+        fprintf(file, "  peak rss: %ld KiB\n", peak_rss());
+        fprintf(file, "  hashmap: %lu lookup(s), %lu probe(s)\n", c->hashmap_lookups, c->hashmap_probes);
+        fprintf(file, "  scopes: %lu lookup(s), %lu probe(s), %lu walk(s)\n", c->scope_lookups, c->scope_probes, c->scope_walks);
+        fprintf(file, "  nodes:\n");
+        for (int i = 0; i < NK_COUNT; i++) {
+                if (total->nodes[i] != 0) {
+                        fprintf(file, "    %-20s %lu\n", node_kind_strings[i], total->nodes[i]);
+                }
+        }
+}
+
+void report_print(report_summary_t* summary, bool time, bool memory)
+{
+        FILE* file;
+
+        file = log_stderr();
+        flockfile(file);
+        if (time) {
+                print_time(file, summary);
+        }
+        if (memory) {
+                print_memory(file, summary);
+        }
+        funlockfile(file);
+}
+
+bool report_write_json(report_summary_t* summary, const char* filename)
+{
+        uint64_t run_wall, run_cpu;
+        report_t* total;
+        counters_t* c;
+        FILE* file;
+        bool status;
+
+        total = &summary->total;
+        run_wall = read_clock(CLOCK_MONOTONIC) - summary->start.wall;
+        run_cpu = read_clock(CLOCK_PROCESS_CPUTIME_ID) - summary->start.cpu;
+
+        file = strcmp(filename, "-") == 0 ? log_stdout() : fopen(filename, "w");
+        if (file == NULL) {
+                return false;
+        }
+
+        c = &total->counters;
+        fprintf(file, "{\n  \"files\": %lu,\n", total->files);
+        fprintf(file, "  \"run\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f},\n", to_ms(run_wall), to_ms(run_cpu));
+        fprintf(file, "  \"phases\": {\n");
+        for (int i = 0; i < PHASE_COUNT; i++) {
+                fprintf(
+                        file,
+                        "    \"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}%s\n",
+                        phase_names[i],
+                        to_ms(total->wall[i]),
+                        to_ms(total->cpu[i]),
+                        i + 1 < PHASE_COUNT ? "," : ""
+                );
+        }
+        fprintf(file, "  },\n");
+        fprintf(file, "  \"source_bytes\": %lu,\n  \"lines\": %lu,\n", total->source_bytes, total->lines);
+        fprintf(file, "  \"tokens\": %lu,\n  \"token_bytes\": %lu,\n", total->tokens, total->token_bytes);
+        fprintf(file, "  \"arena_bytes\": %lu,\n  \"arena_reserved\": %lu,\n", c->arena_bytes, c->arena_reserved);
+        fprintf(file, "  \"peak_rss_kib\": %ld,\n", peak_rss());
+        fprintf(file, "  \"hashmap\": {\"lookups\": %lu, \"probes\": %lu},\n", c->hashmap_lookups, c->hashmap_probes);
+        fprintf(
+                file,
+                "  \"scopes\": {\"lookups\": %lu, \"probes\": %lu, \"walks\": %lu},\n",
+                c->scope_lookups,
+                c->scope_probes,
+                c->scope_walks
+        );
+        fprintf(file, "  \"nodes\": {\n");
+        for (int i = 0; i < NK_COUNT; i++) {
+                fprintf(file, "    \"%s\": %lu%s\n", node_kind_strings[i], total->nodes[i], i + 1 < NK_COUNT ? "," : "");
+        }
+        fprintf(file, "  }\n}\n");
+
+        status = !ferror(file);
+        if (file == log_stdout()) {
+                status = fflush(file) == 0 && status;
+        } else {
+                status = fclose(file) == 0 && status;
+        }
+
+        return status;
+}
+
+void report_destroy(report_summary_t* summary)
+{
+        pthread_mutex_destroy(&summary->lock);
+}
+
+void report_init(report_summary_t* summary)
+{
+        debug("Initializing report...");
+
+        pthread_mutex_init(&summary->lock, NULL);
+        memset(&summary->total, 0, sizeof(report_t));
+        summary->start.wall = read_clock(CLOCK_MONOTONIC);
+        summary->start.cpu = read_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
@@ -0,0 +1,592 @@
+/*
+ * Compile server and its client.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "arena.h"
+#include "compile.h"
+#include "interface.h"
+#include "log.h"
+#include "server.h"
+
+#define MAX_REQUEST_STRINGS 65536
+#define MAX_REQUEST_STRING  (1024 * 1024)
+#define SPARE_CHUNKS        64
+
+/* Every response frame is [type u8][length u32][data] */
+#define FRAME_STDOUT 1
+#define FRAME_STDERR 2
+#define FRAME_STATUS 3
+
+typedef struct {
+        int fd;
+        pthread_mutex_t lock; /* Frames from different threads stay whole */
+        bool failed;
+} connection_t;
+
+typedef struct {
+        connection_t* connection;
+        uint8_t type;
+} stream_t;
+
+/*
+ * Interfaces stay mapped for as long as the server runs, since a session
+ * may still be using one when a newer version is loaded.
+ */
+typedef struct import_entry {
+        struct import_entry* next;
+        struct stat st;
+        struct stat source_st;
+        bool has_source;
+        interface_t interface;
+} import_entry_t;
+
+static volatile sig_atomic_t stopping = 0;
+
+static pthread_mutex_t imports_lock = PTHREAD_MUTEX_INITIALIZER;
+static import_entry_t* loaded_imports = NULL;
+
+static pthread_mutex_t active_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t active_done = PTHREAD_COND_INITIALIZER;
+static size_t n_active = 0;
+
+static bool read_all(int fd, void* data, size_t size)
+{
+        ssize_t n;
+
+        while (size != 0) {
+                n = read(fd, data, size);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                if (n <= 0) {
+                        return false;
+                }
+
+                data = (char*)data + n;
+                size -= (size_t)n;
+        }
+
+        return true;
+}
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+        ssize_t n;
+
+        while (size != 0) {
+                n = write(fd, data, size);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                if (n <= 0) {
+                        return false;
+                }
+
+                data = (const char*)data + n;
+                size -= (size_t)n;
+        }
+
+        return true;
+}
+
+static bool write_string(int fd, const char* string)
+{
+        uint32_t length;
+
+        length = (uint32_t)strlen(string);
+        return write_all(fd, &length, sizeof(length)) && write_all(fd, string, length);
+}
+
+static bool send_frame(connection_t* connection, uint8_t type, const void* data, uint32_t length)
+{
+        bool status;
+
+        pthread_mutex_lock(&connection->lock);
+        status = !connection->failed
+                && write_all(connection->fd, &type, sizeof(type))
+                && write_all(connection->fd, &length, sizeof(length))
+                && write_all(connection->fd, data, length);
+        connection->failed = !status;
+        pthread_mutex_unlock(&connection->lock);
+
+        return status;
+}
+
+static ssize_t stream_write(void* cookie, const char* data, size_t size)
+{
+        stream_t* stream;
+
+        stream = cookie;
+        if (size > UINT32_MAX) {
+                size = UINT32_MAX;
+        }
+
+        if (!send_frame(stream->connection, stream->type, data, (uint32_t)size)) {
+                return -1;
+        }
+
+        return (ssize_t)size;
+}
+
+static FILE* open_stream(stream_t* stream, connection_t* connection, uint8_t type)
+{
+        cookie_io_functions_t functions = { .write = stream_write };
+        FILE* file;
+
+        stream->connection = connection;
+        stream->type = type;
+        file = fopencookie(stream, "w", functions);
+        if (file != NULL) {
+                setvbuf(file, NULL, _IOLBF, 0);
+        }
+
+        return file;
+}
+
+static bool same_file(const struct stat* a, const struct stat* b)
+{
+        return a->st_dev == b->st_dev
+                && a->st_ino == b->st_ino
+                && a->st_size == b->st_size
+                && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+                && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static bool stat_source(const interface_t* interface, struct stat* st)
+{
+        char path[PATH_MAX];
+        uint32_t length;
+
+        length = interface->header->source_path_length;
+        if (length >= sizeof(path)) {
+                return false;
+        }
+
+        memcpy(path, interface_string(interface, interface->header->source_path), length);
+        path[length] = '\0';
+        return stat(path, st) == 0;
+}
+
+static bool still_current(import_entry_t* entry, const struct stat* st)
+{
+        struct stat source_st;
+        bool has_source;
+
+        /* Files are compared by identity, since clients name them from anywhere */
+        if (!same_file(&entry->st, st)) {
+                return false;
+        }
+
+        /* The interface is checked against its source when loaded */
+        has_source = stat_source(&entry->interface, &source_st);
+        return has_source == entry->has_source && (!has_source || same_file(&entry->source_st, &source_st));
+}
+
+static bool load_shared_import(interface_t* interface, const char* filename)
+{
+        import_entry_t* entry;
+        struct stat st;
+
+        if (stat(filename, &st) < 0) {
+                log_errno(filename);
+                return false;
+        }
+
+        pthread_mutex_lock(&imports_lock);
+        for (entry = loaded_imports; entry != NULL; entry = entry->next) {
+                if (still_current(entry, &st)) {
+                        *interface = entry->interface;
+                        pthread_mutex_unlock(&imports_lock);
+                        return true;
+                }
+        }
+
+        entry = calloc(1, sizeof(import_entry_t));
+        if (entry == NULL || !interface_load(&entry->interface, filename)) {
+                pthread_mutex_unlock(&imports_lock);
+                free(entry);
+                return false;
+        }
+
+        entry->st = st;
+        entry->has_source = stat_source(&entry->interface, &entry->source_st);
+        entry->next = loaded_imports;
+        loaded_imports = entry;
+        *interface = entry->interface;
+        pthread_mutex_unlock(&imports_lock);
+
+        return true;
+}
+
+static void unload_shared_imports(void)
+{
+        import_entry_t* entry;
+
+        while ((entry = loaded_imports) != NULL) {
+                loaded_imports = entry->next;
+                interface_unload(&entry->interface);
+                free(entry);
+        }
+}
+
+static void free_request(char** strings)
+{
+        for (size_t i = 0; strings[i] != NULL; i++) {
+                free(strings[i]);
+        }
+
+        free(strings);
+}
+
+static char** read_request(int fd, int* argc)
+{
+        uint32_t count, length;
+        char** strings;
+
+        /* The working directory, then the arguments */
+        if (!read_all(fd, &count, sizeof(count)) || count < 2 || count > MAX_REQUEST_STRINGS) {
+                return NULL;
+        }
+
+        strings = calloc(count + 1, sizeof(char*));
+        if (strings == NULL) {
+                return NULL;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                if (!read_all(fd, &length, sizeof(length)) || length > MAX_REQUEST_STRING) {
+                        free_request(strings);
+                        return NULL;
+                }
+
+                strings[i] = malloc((size_t)length + 1);
+                if (strings[i] == NULL || !read_all(fd, strings[i], length)) {
+                        free_request(strings);
+                        return NULL;
+                }
+                strings[i][length] = '\0';
+        }
+
+        *argc = (int)count - 1;
+        return strings;
+}
+
+static int serve(connection_t* connection, const char* cwd, int argc, char* argv[])
+{
+        stream_t out_stream, err_stream;
+        session_t session;
+        FILE* out;
+        FILE* err;
+        bool status;
+
+        out = open_stream(&out_stream, connection, FRAME_STDOUT);
+        err = open_stream(&err_stream, connection, FRAME_STDERR);
+        if (out == NULL || err == NULL) {
+                if (out != NULL) {
+                        fclose(out);
+                }
+                if (err != NULL) {
+                        fclose(err);
+                }
+                return -1;
+        }
+
+        /*
+         * The thread and the workers it starts get a working directory of
+         * their own, so paths mean what they do to the client.
+         */
+        log_redirect(out, err);
+        if (unshare(CLONE_FS) < 0 || chdir(cwd) < 0) {
+                log_errno(cwd);
+                status = false;
+        } else {
+                status = session_init(&session, argc, argv);
+
+                /* Standard input here is the server's own, not the client's */
+                for (size_t i = 0; status && i < session.n_jobs; i++) {
+                        if (strcmp(session.jobs[i].input_filename, "-") == 0) {
+                                fprintf(err, "Standard input cannot be compiled by a server\n");
+                                status = false;
+                        }
+                }
+
+                if (status) {
+                        session.out = out;
+                        session.err = err;
+                        session.load_import = load_shared_import;
+                        status = session_run(&session);
+                }
+
+                session_destroy(&session);
+        }
+
+        log_redirect(NULL, NULL);
+        fclose(out);
+        fclose(err);
+
+        return status ? 0 : -1;
+}
+
+static void* handle_connection(void* arg)
+{
+        connection_t* connection;
+        char** strings;
+        int32_t exit_status;
+        int argc;
+
+        connection = arg;
+        strings = read_request(connection->fd, &argc);
+        if (strings != NULL) {
+                /* argv[0] is the client's own name */
+                exit_status = serve(connection, strings[0], argc, strings + 1);
+                send_frame(connection, FRAME_STATUS, &exit_status, sizeof(exit_status));
+                free_request(strings);
+        }
+
+        close(connection->fd);
+        pthread_mutex_destroy(&connection->lock);
+        free(connection);
+
+        pthread_mutex_lock(&active_lock);
+        if (--n_active == 0) {
+                pthread_cond_signal(&active_done);
+        }
+        pthread_mutex_unlock(&active_lock);
+
+        return NULL;
+}
+
+/* Requests run with the server's files and permissions, so only its own user may send them */
+static bool same_user(int fd)
+{
+        struct ucred credentials;
+        socklen_t length;
+
+        length = sizeof(credentials);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0) {
+                return false;
+        }
+
+        return credentials.uid == getuid();
+}
+
+static void start_connection(int fd)
+{
+        connection_t* connection;
+        pthread_attr_t attr;
+        pthread_t thread;
+
+        connection = malloc(sizeof(connection_t));
+        if (connection == NULL) {
+                close(fd);
+                return;
+        }
+
+        connection->fd = fd;
+        connection->failed = false;
+        pthread_mutex_init(&connection->lock, NULL);
+
+        pthread_mutex_lock(&active_lock);
+        n_active++;
+        pthread_mutex_unlock(&active_lock);
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, handle_connection, connection) != 0) {
+                fprintf(stderr, "Failed to start connection thread\n");
+                pthread_mutex_lock(&active_lock);
+                n_active--;
+                pthread_mutex_unlock(&active_lock);
+                pthread_mutex_destroy(&connection->lock);
+                free(connection);
+                close(fd);
+        }
+        pthread_attr_destroy(&attr);
+}
+
+static void stop(int signal)
+{
+        (void)signal;
+        stopping = 1;
+}
+
+static bool make_address(struct sockaddr_un* addr, const char* path)
+{
+        memset(addr, 0, sizeof(struct sockaddr_un));
+        addr->sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr->sun_path)) {
+                fprintf(stderr, "%s: socket path is too long\n", path);
+                return false;
+        }
+
+        strcpy(addr->sun_path, path);
+        return true;
+}
+
+bool server_run(const char* path)
+{
+        struct sockaddr_un addr;
+        struct sigaction action;
+        sigset_t signals, old_signals;
+        int listen_fd, fd;
+        mode_t old_mask;
+        bool status;
+
+        debug("Starting server...");
+
+        if (!make_address(&addr, path)) {
+                return false;
+        }
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+                perror("socket");
+                return false;
+        }
+
+        /* A socket left behind by a server that died is replaced */
+        unlink(path);
+
+        /* Other users cannot even connect, the socket is created private */
+        old_mask = umask(0177);
+        status = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        umask(old_mask);
+        if (!status || chmod(path, 0600) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+                perror(path);
+                close(listen_fd);
+                return false;
+        }
+
+        /* Without SA_RESTART, accept() returns when asked to stop */
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+
+        arena_keep_chunks(SPARE_CHUNKS);
+
+        while (!stopping) {
+                fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                        }
+
+                        perror("accept");
+                        break;
+                }
+
+                if (!same_user(fd)) {
+                        fprintf(stderr, "Refused a client run by another user\n");
+                        close(fd);
+                        continue;
+                }
+
+                /* Only this thread handles signals */
+                pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+                start_connection(fd);
+                pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+        }
+
+        close(listen_fd);
+        unlink(path);
+
+        /* Let requests in progress finish */
+        pthread_mutex_lock(&active_lock);
+        while (n_active != 0) {
+                pthread_cond_wait(&active_done, &active_lock);
+        }
+        pthread_mutex_unlock(&active_lock);
+
+        unload_shared_imports();
+        arena_keep_chunks(0);
+        return true;
+}
+
+bool client_run(const char* path, int argc, char* argv[], int* exit_status)
+{
+        struct sockaddr_un addr;
+        char cwd[PATH_MAX];
+        char buffer[4096];
+        uint32_t count, length, n;
+        int32_t status;
+        uint8_t type;
+        bool done, served;
+        FILE* file;
+        int fd;
+
+        if (!make_address(&addr, path) || getcwd(cwd, sizeof(cwd)) == NULL) {
+                return false;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                return false;
+        }
+
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+                close(fd);
+                return false;
+        }
+
+        signal(SIGPIPE, SIG_IGN);
+        count = (uint32_t)argc + 1;
+        done = write_all(fd, &count, sizeof(count)) && write_string(fd, cwd);
+        for (int i = 0; i < argc && done; i++) {
+                done = write_string(fd, argv[i]);
+        }
+
+        /* Relay output until the exit status arrives */
+        served = false;
+        while (done && !served) {
+                if (!read_all(fd, &type, sizeof(type)) || !read_all(fd, &length, sizeof(length))) {
+                        break;
+                }
+
+                if (type == FRAME_STATUS) {
+                        served = length == sizeof(status) && read_all(fd, &status, sizeof(status));
+                        break;
+                }
+
+                file = type == FRAME_STDOUT ? stdout : stderr;
+                while (length != 0 && done) {
+                        n = length < sizeof(buffer) ? length : sizeof(buffer);
+                        done = read_all(fd, buffer, n);
+                        fwrite(buffer, 1, n, file);
+                        length -= n;
+                }
+        }
+
+        close(fd);
+        if (!served) {
+                fprintf(stderr, "Lost connection to the server at %s\n", path);
+                status = -1;
+        }
+
+        *exit_status = status;
+        return true;
+}
@@ -0,0 +1,150 @@
+/*
+ * SHA-256 message digest.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t ror(uint32_t x, int n)
+{
+        return (x >> n) | (x << (32 - n));
+}
+
+static void compress(sha256_t* ctx, const uint8_t* block)
+{
+        uint32_t w[64];
+        uint32_t a, b, c, d, e, f, g, h, t1, t2;
+
+        for (int i = 0; i < 16; i++) {
+                w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16
+                        | (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+        }
+
+        for (int i = 16; i < 64; i++) {
+                w[i] = w[i - 16] + (ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3))
+                        + w[i - 7] + (ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10));
+        }
+
+        a = ctx->state[0];
+        b = ctx->state[1];
+        c = ctx->state[2];
+        d = ctx->state[3];
+        e = ctx->state[4];
+        f = ctx->state[5];
+        g = ctx->state[6];
+        h = ctx->state[7];
+
+        for (int i = 0; i < 64; i++) {
+                t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+                t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+        }
+
+        ctx->state[0] += a;
+        ctx->state[1] += b;
+        ctx->state[2] += c;
+        ctx->state[3] += d;
+        ctx->state[4] += e;
+        ctx->state[5] += f;
+        ctx->state[6] += g;
+        ctx->state[7] += h;
+}
+
+void sha256_update(sha256_t* ctx, const void* data, size_t length)
+{
+        const uint8_t* bytes;
+        size_t n;
+
+        bytes = data;
+        ctx->length += length;
+
+        /* Top up a partial block first */
+        if (ctx->used > 0) {
+                n = sizeof(ctx->block) - ctx->used;
+                if (n > length) {
+                        n = length;
+                }
+
+                memcpy(ctx->block + ctx->used, bytes, n);
+                ctx->used += n;
+                bytes += n;
+                length -= n;
+
+                if (ctx->used < sizeof(ctx->block)) {
+                        return;
+                }
+
+                compress(ctx, ctx->block);
+                ctx->used = 0;
+        }
+
+        for (; length >= sizeof(ctx->block); length -= sizeof(ctx->block)) {
+                compress(ctx, bytes);
+                bytes += sizeof(ctx->block);
+        }
+
+        memcpy(ctx->block, bytes, length);
+        ctx->used = length;
+}
+
+void sha256_final(sha256_t* ctx, uint8_t digest[SHA256_SIZE])
+{
+        uint64_t bits;
+
+        bits = ctx->length * 8;
+
+        /* Pad with 0x80, zeros, then the length in bits */
+        ctx->block[ctx->used++] = 0x80;
+        if (ctx->used > sizeof(ctx->block) - 8) {
+                memset(ctx->block + ctx->used, 0, sizeof(ctx->block) - ctx->used);
+                compress(ctx, ctx->block);
+                ctx->used = 0;
+        }
+
+        memset(ctx->block + ctx->used, 0, sizeof(ctx->block) - 8 - ctx->used);
+        for (int i = 0; i < 8; i++) {
+                ctx->block[63 - i] = (uint8_t)(bits >> (i * 8));
+        }
+        compress(ctx, ctx->block);
+
+        for (int i = 0; i < 8; i++) {
+                digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+                digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+                digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+                digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+        }
+}
+
+void sha256_init(sha256_t* ctx)
+{
+        ctx->state[0] = 0x6a09e667;
+        ctx->state[1] = 0xbb67ae85;
+        ctx->state[2] = 0x3c6ef372;
+        ctx->state[3] = 0xa54ff53a;
+        ctx->state[4] = 0x510e527f;
+        ctx->state[5] = 0x9b05688c;
+        ctx->state[6] = 0x1f83d9ab;
+        ctx->state[7] = 0x5be0cd19;
+        ctx->length = 0;
+        ctx->used = 0;
+}
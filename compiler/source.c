@@ -0,0 +1,138 @@
+/*
+ * Source file loading.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lexer.h"
+#include "log.h"
+#include "source.h"
+
+/*
+ * Maps the file over the start of a zeroed anonymous region. The tail
+ * of the last file page reads as zeroes, and the anonymous pages after
+ * it supply the rest of the padding, including when the file size is
+ * an exact multiple of the page size.
+ */
+static bool map_file(source_t* source, int fd)
+{
+        size_t page_size;
+        char* region;
+
+        page_size = (size_t)sysconf(_SC_PAGESIZE);
+        source->map_size = (source->size + 1 + LEXER_PADDING + page_size - 1) & ~(page_size - 1);
+
+        region = mmap(NULL, source->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+                return false;
+        }
+
+        if (mmap(region, source->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(region, source->map_size);
+                return false;
+        }
+
+        source->data = region;
+        return true;
+}
+
+/* Fallback for files that cannot be mapped */
+static bool read_file(source_t* source, int fd)
+{
+        size_t n_read;
+
+        source->map_size = 0;
+        source->data = malloc(source->size + 1 + LEXER_PADDING);
+        if (source->data == NULL) {
+                return false;
+        }
+
+        n_read = 0;
+        while (n_read < source->size) {
+                ssize_t n;
+
+                n = read(fd, &source->data[n_read], source->size - n_read);
+                if (n <= 0) {
+                        free(source->data);
+                        return false;
+                }
+
+                n_read += (size_t)n;
+        }
+
+        /* Terminate string and pad it for the lexer's vector loads */
+        memset(&source->data[source->size], 0, 1 + LEXER_PADDING);
+        return true;
+}
+
+bool source_load(source_t* source, const char* filename)
+{
+        struct stat st;
+        bool status;
+        int fd;
+
+        debug("Loading source...");
+
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+                return false;
+        }
+
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 1) {
+                close(fd);
+                errno = EINVAL;
+                return false;
+        }
+
+        /* Tokens locate themselves with 32-bit offsets, up to and including the end */
+        if ((uint64_t)st.st_size > UINT32_MAX) {
+                close(fd);
+                errno = EFBIG;
+                return false;
+        }
+
+        source->size = (size_t)st.st_size;
+        status = map_file(source, fd) || read_file(source, fd);
+        close(fd);
+
+        return status;
+}
+
+/*
+ * Standard input ("-") and pipes cannot be mapped or sized up front,
+ * so they are lexed as they are read. Returns -1 for regular files
+ * unless streaming is forced.
+ */
+int source_open_stream(const char* filename, bool force)
+{
+        struct stat st;
+
+        if (strcmp(filename, "-") == 0) {
+                return dup(STDIN_FILENO);
+        }
+
+        if (!force && (stat(filename, &st) != 0 || S_ISREG(st.st_mode))) {
+                return -1;
+        }
+
+        return open(filename, O_RDONLY);
+}
+
+void source_unload(source_t* source)
+{
+        if (source->map_size != 0) {
+                munmap(source->data, source->map_size);
+        } else {
+                free(source->data);
+        }
+
+        source->data = NULL;
+}
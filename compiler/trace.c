@@ -0,0 +1,166 @@
+/*
+ * Chrome trace timelines.
+ * Copyright (c) 2023-2024, Quinn Stephens.
+ * Provided under the BSD 3-Clause license.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "log.h"
+#include "trace.h"
+
+static _Thread_local trace_t* current;
+static _Thread_local uint32_t thread_id;
+
+static uint64_t read_clock(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void trace_bind(trace_t* trace)
+{
+        current = trace;
+}
+
+trace_t* trace_current(void)
+{
+        return current;
+}
+
+void trace_add(const char* category, const char* name, size_t length, uint64_t start, uint64_t end)
+{
+        trace_event_t* event;
+        trace_t* trace;
+        char* copy;
+
+        trace = current;
+        if (trace == NULL) {
+                return;
+        }
+
+        if (thread_id == 0) {
+                thread_id = (uint32_t)gettid();
+        }
+
+        /* Names may be gone by the time the trace is written */
+        pthread_mutex_lock(&trace->lock);
+        if (trace->count == trace->capacity) {
+                size_t capacity;
+
+                capacity = trace->capacity != 0 ? trace->capacity * 2 : 1024;
+                event = realloc(trace->events, capacity * sizeof(trace_event_t));
+                if (event == NULL) {
+                        pthread_mutex_unlock(&trace->lock);
+                        return;
+                }
+
+                trace->events = event;
+                trace->capacity = capacity;
+        }
+
+        copy = arena_alloc(&trace->names, length + 1);
+        if (copy == NULL) {
+                pthread_mutex_unlock(&trace->lock);
+                return;
+        }
+        memcpy(copy, name, length);
+        copy[length] = '\0';
+
+        event = &trace->events[trace->count++];
+        event->start = start;
+        event->duration = end - start;
+        event->thread = thread_id;
+        event->category = category;
+        event->name = copy;
+        pthread_mutex_unlock(&trace->lock);
+}
+
+void trace_begin(trace_span_t* span)
+{
+        span->start = current != NULL ? read_clock() : 0;
+}
+
+void trace_end(trace_span_t* span, const char* category, const char* name, size_t length)
+{
+        if (span->start != 0) {
+                trace_add(category, name, length, span->start, read_clock());
+        }
+}
+
+static void write_string(FILE* file, const char* string)
+{
+        fputc('"', file);
+        for (; *string != '\0'; string++) {
+                if (*string == '"' || *string == '\\') {
+                        fprintf(file, "\\%c", *string);
+                } else if ((unsigned char)*string < 0x20) {
+                        fprintf(file, "\\u%04x", *string);
+                } else {
+                        fputc(*string, file);
+                }
+        }
+        fputc('"', file);
+}
+
+bool trace_write(trace_t* trace, const char* filename)
+{
+        trace_event_t* event;
+        FILE* file;
+        bool status;
+        int pid;
+
+        file = fopen(filename, "w");
+        if (file == NULL) {
+                return false;
+        }
+
+        /* Complete ("X") events, in microseconds from the start of the run */
+        pid = (int)getpid();
+        fprintf(file, "{\"traceEvents\": [\n");
+        for (size_t i = 0; i < trace->count; i++) {
+                event = &trace->events[i];
+                fprintf(file, "  {\"name\": ");
+                write_string(file, event->name);
+                fprintf(
+                        file,
+                        ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %u}%s\n",
+                        event->category,
+                        (double)(event->start - trace->origin) / 1000.0,
+                        (double)event->duration / 1000.0,
+                        pid,
+                        event->thread,
+                        i + 1 < trace->count ? "," : ""
+                );
+        }
+        fprintf(file, "], \"displayTimeUnit\": \"ms\"}\n");
+
+        status = !ferror(file);
+        status = fclose(file) == 0 && status;
+        return status;
+}
+
+void trace_destroy(trace_t* trace)
+{
+        free(trace->events);
+        arena_destroy(&trace->names);
+        pthread_mutex_destroy(&trace->lock);
+}
+
+void trace_init(trace_t* trace)
+{
+        debug("Initializing trace...");
+
+        pthread_mutex_init(&trace->lock, NULL);
+        trace->events = NULL;
+        trace->count = 0;
+        trace->capacity = 0;
+        arena_init(&trace->names);
+        trace->origin = read_clock();
+}